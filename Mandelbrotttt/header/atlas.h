@@ -0,0 +1,23 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <string>
+#include "escape.h"
+
+// Julia parameter atlas: a grid x grid sheet of thumb x thumb Julia sets, one per c,
+// with c sampled at the thumbnail centres over [minRe, maxRe] x [minIm, maxIm]
+// (defaults: the Mandelbrot start view). Thumbnails show z in [-1.6, 1.6]^2.
+struct AtlasOptions {
+    std::string path = "img/atlas.png";
+    int    grid   = 16;
+    int    thumb  = 64;
+    double minRe  = -2.0, maxRe = 1.0;
+    double minIm  = -1.5, maxIm = 1.5;
+    int    threads = 0;    // 0 = hardware_concurrency()
+    escape::Formula   formula   = escape::Formula::Mandelbrot;
+    escape::Precision precision = escape::Precision::Double;
+};
+
+int run_atlas(const AtlasOptions& opt);
+
+#endif
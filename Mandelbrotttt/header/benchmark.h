@@ -2,7 +2,51 @@
 #define BENCHMARK_H
 
 #include <string>
+#include "escape.h"
 
-int run_benchmark(int width, int height, const std::string& out_png);
+// Benchmark suite: each named scene is rendered warmup times untimed, then reps
+// times timed, single-threaded and on `threads` threads. Results go to the
+// console, a PNG summary card at out, and out's stem + .csv / .json. Throughput is
+// also given in giga-iterations per second (escape::iteration_count), which unlike
+// ms per frame compares across scenes. With perf set, cycles, instructions (IPC),
+// branch and cache misses are counted around each timed render, for the whole
+// render and per worker; if the counters can't be opened the run goes on without.
+// With scaling set, every scene runs on 1, 2, 4, ... and `threads` threads and the
+// card gets a speedup chart. Each row also has the parallel efficiency and the
+// load imbalance (slowest worker's busy time over the mean worker's).
+//   scenes: full      default Mandelbrot view
+//           seahorse  zoom on the seahorse valley (boundary-heavy)
+//           interior  mostly inside the main cardioid (maxIter-bound)
+//           deep      1e-9-wide zoom, maxIter 2000
+//           julia     default Julia view
+struct BenchOptions {
+    int width   = 720;
+    int height  = 480;
+    int reps    = 5;
+    int warmup  = 1;
+    int threads = 0;        // 0 = hardware_concurrency()
+    bool scaling = false;   // sweep powers of two up to threads
+    bool perf    = false;   // hardware counters per render (PerfCounters), if the OS allows
+    std::string baseline;   // compare against (or, if missing, save as) this file
+    bool updateBaseline = false;   // overwrite the baseline after comparing
+    double threshold = 5.0;        // % slower median that counts as a regression
+    std::string scenes;     // comma-separated names, empty = all
+    std::string out = "img/benchmark/benchmark.png";
+    escape::Formula   formula   = escape::Formula::Mandelbrot;
+    escape::Precision precision = escape::Precision::Double;
+};
+
+// With a baseline file that exists, every scene and thread count is compared
+// against it: a scene regresses when its median is more than threshold % slower
+// and a one-sided Mann-Whitney test on the runs says so at p < 0.05.
+// Returns 0, 1 on errors, 2 if a scene regressed.
+int run_benchmark(const BenchOptions& opt);
+
+// Kernel microbenchmark: every escape kernel on fixed 128x128 point batches
+// (full view, seahorse valley, a Julia set), one thread, maxIter 1000. Scalar
+// iterate() in double and float, and iterate_streams with 4 and 8 lanes (Julia
+// batch only: it takes one c per lane). Reports Giter/s and ns per iteration to
+// the console and out's stem + _kernels.csv. scenes selects batches.
+int run_kernel_bench(const BenchOptions& opt);
 
 #endif
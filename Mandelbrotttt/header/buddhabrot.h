@@ -0,0 +1,67 @@
+#ifndef BUDDHABROT_H
+#define BUDDHABROT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Orbit-density ("Buddhabrot") renderer: instead of colouring c by its escape
+// count, the orbits of escaping c are traced and every point they visit is
+// counted in a density image.
+class Buddhabrot {
+public:
+    // c is drawn from [-2, 2]^2; orbits shorter than minIter are dropped
+    Buddhabrot(int width, int height, int maxIter = 1000, int minIter = 20);
+
+    // image viewport (default: the Mandelbrot start view)
+    void setView(double minRe, double maxRe, double minIm, double maxIm);
+
+    // Traces `samples` more orbits (uniform) or chain steps (Metropolis). Each thread
+    // splats into its own histogram; they are added to the density at the end.
+    // Metropolis-Hastings keeps one chain of c per thread, proposing small moves (and
+    // now and then a fresh uniform c), accepted by the ratio of in-view orbit points;
+    // splats are weighted by 1 / points so the image is still the uniform density.
+    void accumulate(uint64_t samples, bool metropolis, uint64_t seed = 1, int threadCount = 0);
+
+    // sqrt-scaled gray, white = densest pixel
+    void tonemap(uint32_t* dst) const;
+
+    // Accumulation state (settings + density) so a long run can be resumed.
+    // load_checkpoint fails on a missing file or different settings.
+    bool save_checkpoint(const std::string& path) const;
+    bool load_checkpoint(const std::string& path);
+
+    uint64_t samples() const { return done; }
+    bool metropolis() const { return useMetropolis; }
+
+    double minRe, maxRe, minIm, maxIm;
+
+private:
+    int width, height;
+    int maxIter, minIter;
+    bool useMetropolis;
+    uint64_t done;
+    std::vector<double> density;
+
+    // pixel indices of the in-view orbit points of c (and their mirror images, the
+    // orbit of conj c) into out; empty if c doesn't escape within [minIter, maxIter)
+    void trace(double cr, double ci, std::vector<double>& scratch,
+               std::vector<uint32_t>& out) const;
+};
+
+struct BuddhaOptions {
+    std::string path = "img/buddhabrot.png";
+    int      width = 720, height = 480;
+    uint64_t samples = 20000000;
+    int      maxIter = 1000, minIter = 20;
+    bool     metropolis = false;
+    bool     customView = false;          // else the Mandelbrot start view
+    double   minRe = -2.0, maxRe = 1.0, minIm = -1.0, maxIm = 1.0;
+    std::string checkpoint;               // empty = no checkpoints
+    uint64_t checkpointEvery = 5000000;   // samples between checkpoint writes
+    int      threads = 0;                 // 0 = hardware_concurrency()
+};
+
+int run_buddhabrot(const BuddhaOptions& opt);
+
+#endif
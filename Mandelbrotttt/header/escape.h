@@ -0,0 +1,487 @@
+#ifndef ESCAPE_H
+#define ESCAPE_H
+
+// Escape-time engine shared by Fractal and Julia.
+//
+// A kernel is Formula x Real x Color, all picked at compile time, so every
+// combination becomes its own loop with the step and the colouring inlined
+// (no virtual call or switch per pixel). The runtime choice is made once per
+// band in dispatch().
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include "trace.h"
+
+namespace escape {
+
+// ---- formulas ----------------------------------------------------------------
+// step() advances z once; power is the degree (for the smooth value);
+// julia = true starts from z = pixel with a fixed c instead of z = 0, c = pixel;
+// mirrorsReal = step(conj z, conj c) is conj(step(z, c)).
+// analytic formulas also have deriv(): dz -> f'(z) dz, for distance estimation.
+
+struct Mandelbrot {
+    static constexpr bool mirrorsReal = true;
+    static constexpr bool analytic = true;
+    static constexpr int  power = 2;
+    static constexpr bool julia = false;
+    template <class T>
+    static void step(T& zr, T& zi, T cr, T ci) {
+        T tmp = zr*zr - zi*zi + cr;
+        zi = T(2) * zr * zi + ci;
+        zr = tmp;
+    }
+    template <class T>
+    static void deriv(T& dr, T& di, T zr, T zi) {
+        T tmp = T(2) * (zr*dr - zi*di);
+        di = T(2) * (zr*di + zi*dr);
+        dr = tmp;
+    }
+};
+
+// z -> z^D + c; the multiply loop has a constant trip count and unrolls
+template <int D>
+struct Multibrot {
+    static constexpr bool mirrorsReal = true;
+    static constexpr bool analytic = true;
+    static_assert(D >= 2, "Multibrot power must be >= 2");
+    static constexpr int  power = D;
+    static constexpr bool julia = false;
+    template <class T>
+    static void step(T& zr, T& zi, T cr, T ci) {
+        T r = zr, i = zi;
+        for (int k = 1; k < D; ++k) {
+            T t = r*zr - i*zi;
+            i = r*zi + i*zr;
+            r = t;
+        }
+        zr = r + cr;
+        zi = i + ci;
+    }
+    // dz -> D z^(D-1) dz
+    template <class T>
+    static void deriv(T& dr, T& di, T zr, T zi) {
+        T r = dr, i = di;
+        for (int k = 1; k < D; ++k) {
+            T t = r*zr - i*zi;
+            i = r*zi + i*zr;
+            r = t;
+        }
+        dr = T(D) * r;
+        di = T(D) * i;
+    }
+};
+
+// z -> (|Re z| + i|Im z|)^2 + c
+struct BurningShip {
+    static constexpr bool mirrorsReal = false;
+    static constexpr bool analytic = false;
+    static constexpr int  power = 2;
+    static constexpr bool julia = false;
+    template <class T>
+    static void step(T& zr, T& zi, T cr, T ci) {
+        T ar = std::abs(zr), ai = std::abs(zi);
+        zr = ar*ar - ai*ai + cr;
+        zi = T(2) * ar * ai + ci;
+    }
+};
+
+// z -> conj(z)^2 + c
+struct Tricorn {
+    static constexpr bool mirrorsReal = true;
+    static constexpr bool analytic = false;
+    static constexpr int  power = 2;
+    static constexpr bool julia = false;
+    template <class T>
+    static void step(T& zr, T& zi, T cr, T ci) {
+        T tmp = zr*zr - zi*zi + cr;
+        zi = T(-2) * zr * zi + ci;
+        zr = tmp;
+    }
+};
+
+// the Julia set of any of the above
+template <class Base>
+struct JuliaOf : Base {
+    static constexpr bool julia = true;
+};
+
+// f(-z) == f(z) for even powers (Burning Ship's |.| and Tricorn's conj keep that),
+// so the Julia sets of these are symmetric under z -> -z
+template <class F>
+constexpr bool point_symmetric = F::power % 2 == 0;
+
+// with c taken from the pixel, such a set is symmetric about the real axis
+template <class F>
+constexpr bool real_symmetric = !F::julia && F::mirrorsReal;
+
+// ---- colouring ---------------------------------------------------------------
+// color() gets the escape count and the final z; Out is what lands in the buffer.
+
+// white outside fading to black inside (the Mandelbrot view)
+struct Gray {
+    using Out = uint32_t;
+    static uint32_t value(int n, int maxIter) {
+        uint8_t s = uint8_t(255 - (255.0 * n / maxIter));
+        return (255u << 24) | (s << 16) | (s << 8) | s; // ARGB gray
+    }
+    template <class F, class T>
+    static Out color(int n, T, T, int maxIter) { return value(n, maxIter); }
+};
+
+// modular RGB bands, black inside (the Julia view)
+struct Bands {
+    using Out = uint32_t;
+    static uint32_t value(int n, int maxIter) {
+        if (n == maxIter) return 0xFF000000u;
+        uint8_t r = (n * 9) % 256;
+        uint8_t g = (n * 7) % 256;
+        uint8_t b = (n * 5) % 256;
+        return (0xFFu << 24) | (r << 16) | (g << 8) | b;
+    }
+    template <class F, class T>
+    static Out color(int n, T, T, int maxIter) { return value(n, maxIter); }
+};
+
+// raw escape count (maxIter = inside)
+struct Iterations {
+    using Out = uint32_t;
+    template <class F, class T>
+    static Out color(int n, T, T, int) { return uint32_t(n); }
+};
+
+// escape count with the final z, so an unescaped orbit can be continued later
+struct OrbitPoint {
+    double   zr, zi;
+    uint32_t n;
+};
+struct Orbit {
+    using Out = OrbitPoint;
+    template <class F, class T>
+    static Out color(int n, T zr, T zi, int) { return { double(zr), double(zi), uint32_t(n) }; }
+};
+
+// continuous count n + 1 - log_d(log|z|), maxIter inside
+struct Smooth {
+    using Out = float;
+    template <class F, class T>
+    static Out color(int n, T zr, T zi, int maxIter) {
+        if (n == maxIter) return float(maxIter);
+        double l = 0.5 * std::log(double(zr)*double(zr) + double(zi)*double(zi));
+        if constexpr (F::power == 2) return float(n + 1 - std::log2(l));
+        else return float(n + 1 - std::log(l) / std::log(double(F::power)));
+    }
+};
+
+// ---- view & kernels -----------------------------------------------------------
+
+struct View {
+    double minRe, maxRe, minIm, maxIm;
+    int    width, height;
+    int    maxIter;
+    double cRe = 0.0, cIm = 0.0;     // Julia constant (ignored by the others)
+    int    mirrorSum = -1;           // rows y and mirrorSum - y at conjugate heights (-1: none)
+    int    mirrorCols = -1;          // columns x and mirrorCols - x at negated real parts (-1: none)
+};
+
+// Imaginary part of row y (moved by jy rows); iF is the row spacing. With the real
+// axis on the pixel grid, rows below it are placed as the exact negatives of their
+// partners above, so a row copied across the axis is bit-identical to a computed one.
+inline double row_im(const View& v, double iF, int y, double jy = 0.0) {
+    if (v.mirrorSum >= 0 && jy == 0.0 && 2 * y > v.mirrorSum && v.mirrorSum - y >= 0)
+        return -(v.maxIm - (v.mirrorSum - y) * iF);
+    return v.maxIm - (y + jy) * iF;
+}
+
+// Real part of column x, the same way: with mirrorCols set (a Julia view centred
+// on 0), the right half is placed at the exact negatives of the left half
+inline double col_re(const View& v, double rF, int x, double jx = 0.0) {
+    if (v.mirrorCols >= 0 && jx == 0.0 && 2 * x > v.mirrorCols && v.mirrorCols - x >= 0)
+        return -(v.minRe + (v.mirrorCols - x) * rF);
+    return v.minRe + (x + jx) * rF;
+}
+
+// escape count for one point; z is left at its last value
+template <class F, class Real>
+inline int iterate(Real& zr, Real& zi, Real cr, Real ci, int maxIter) {
+    int n = 0;
+    while (n < maxIter && zr*zr + zi*zi <= Real(4)) {
+        F::step(zr, zi, cr, ci);
+        ++n;
+    }
+    return n;
+}
+
+// c in the main cardioid or the period-2 bulb: z^2 + c never escapes there
+inline bool in_main_bulbs(double cr, double ci) {
+    double q = (cr - 0.25) * (cr - 0.25) + ci * ci;
+    if (q * (q + (cr - 0.25)) <= 0.25 * ci * ci) return true;
+    return (cr + 1.0) * (cr + 1.0) + ci * ci <= 0.0625;
+}
+
+// L independent streams of Julia orbits, one c per lane: lane l walks indices
+// 0..count-1, z0(l, i, zr, zi) gives the start of orbit i and emit(l, i, n) takes
+// its escape count (equal to iterate()'s). Lanes are stepped together, branch-free,
+// in short bursts (escaped lanes frozen by a select); between bursts a finished lane
+// is refilled with its next orbit, so one slow orbit doesn't idle the others.
+template <class F, int L, class Real, class Z0, class Emit>
+inline void iterate_streams(const Real* cr, const Real* ci, int count, int maxIter,
+                            Z0 z0, Emit emit)
+{
+    constexpr int burst = 4;
+    Real zr[L], zi[L];
+    int  n[L], idx[L];
+    int  live = 0;
+    for (int l = 0; l < L; ++l) {
+        idx[l] = 0; n[l] = 0;
+        if (count > 0) { z0(l, 0, zr[l], zi[l]); ++live; }
+        else           { zr[l] = Real(4); zi[l] = Real(0); }
+    }
+    while (live) {
+        for (int s = 0; s < burst; ++s) {
+            for (int l = 0; l < L; ++l) {
+                Real r = zr[l], i = zi[l];
+                bool in = n[l] < maxIter && r*r + i*i <= Real(4);
+                F::step(r, i, cr[l], ci[l]);
+                zr[l] = in ? r : zr[l];
+                zi[l] = in ? i : zi[l];
+                n[l] += in;
+            }
+        }
+        for (int l = 0; l < L; ++l) {
+            if (idx[l] >= count) continue;
+            if (n[l] < maxIter && zr[l]*zr[l] + zi[l]*zi[l] <= Real(4)) continue;
+            emit(l, idx[l], n[l]);
+            n[l] = 0;
+            if (++idx[l] < count) {
+                z0(l, idx[l], zr[l], zi[l]);
+            } else {
+                zr[l] = Real(4); zi[l] = Real(0);   // parked: fails the bailout test
+                --live;
+            }
+        }
+    }
+}
+
+// Escape count (same as iterate()) plus the exterior distance estimate
+// 0.5 |z| ln|z| / |dz/dc| (dz/dz0 for Julia sets) in de, -1 inside. Only escaping
+// orbits pay for the derivative: they are replayed with it (same z sequence), then
+// run a few steps past |z| = 2 so the estimate has settled.
+template <class F, class Real>
+inline int iterate_de(Real zr, Real zi, Real cr, Real ci, int maxIter, double& de) {
+    static_assert(F::analytic, "distance estimation needs an analytic formula");
+    const Real zr0 = zr, zi0 = zi;
+    int n = iterate<F>(zr, zi, cr, ci, maxIter);
+    if (n == maxIter) { de = -1.0; return n; }
+
+    zr = zr0; zi = zi0;
+    Real dr = F::julia ? Real(1) : Real(0), di = Real(0);
+    for (int k = 0; k < n + 8; ++k) {
+        if (k >= n && zr*zr + zi*zi > Real(1e6)) break;
+        F::deriv(dr, di, zr, zi);
+        if constexpr (!F::julia) dr += Real(1);
+        F::step(zr, zi, cr, ci);
+    }
+    double r = std::hypot(double(zr), double(zi)), d = std::hypot(double(dr), double(di));
+    de = d > 0.0 && std::isfinite(d) ? 0.5 * r * std::log(r) / d : 0.0;
+    return n;
+}
+
+// one sample at the complex point (re, im); n gets its escape count
+template <class F, class Real, class Color>
+inline typename Color::Out sample(const View& v, double re, double im, int& n) {
+    Real zr, zi, cr, ci;
+    if constexpr (F::julia) { zr = Real(re); zi = Real(im); cr = Real(v.cRe); ci = Real(v.cIm); }
+    else                    { zr = Real(0);  zi = Real(0);  cr = Real(re);    ci = Real(im); }
+    n = iterate<F>(zr, zi, cr, ci, v.maxIter);
+    return Color::template color<F>(n, zr, zi, v.maxIter);
+}
+
+template <class F, class Real, class Color>
+inline typename Color::Out sample(const View& v, double re, double im) {
+    int n;
+    return sample<F, Real, Color>(v, re, im, n);
+}
+
+// While set, render_rows and distance_rows add the iterations they performed (the
+// sum of the escape counts, = F::step calls) here, once per call. For throughput figures.
+inline std::atomic<uint64_t>* iteration_count = nullptr;
+
+// rows [y0, y1) of the view into dst (dst points at row y0); every sample is
+// moved by (jx, jy) pixels
+template <class F, class Real, class Color>
+void render_rows(typename Color::Out* dst, const View& v, int y0, int y1,
+                 double jx = 0.0, double jy = 0.0)
+{
+    double rF = (v.maxRe - v.minRe) / double(v.width - 1);
+    double iF = (v.maxIm - v.minIm) / double(v.height - 1);
+
+    // the column placement in locals: out may alias View's ints, so col_re per
+    // pixel would reload them after every store
+    const int w = v.width;
+    const int xm = v.mirrorCols >= 0 && jx == 0.0 ? v.mirrorCols / 2 + 1 : w;   // mirrored: [xm, mc]
+    const int mc = v.mirrorCols;
+    const double minRe = v.minRe;
+
+    uint64_t work = 0;
+    for (int y = y0; y < y1; ++y) {
+        double im = row_im(v, iF, y, jy);
+        typename Color::Out* out = dst + size_t(y - y0) * w;
+        for (int x = 0; x < w; ++x) {
+            int n;
+            double re = x < xm || x > mc ? minRe + (x + jx) * rF : -(minRe + (mc - x) * rF);
+            out[x] = sample<F, Real, Color>(v, re, im, n);
+            work += uint64_t(n);
+        }
+    }
+    if (iteration_count) *iteration_count += work;
+}
+
+// rows [y0, y1) as escape counts (may be null) and distance estimates in complex
+// units (-1 inside)
+template <class F, class Real>
+void distance_rows(uint32_t* iters, float* de, const View& v, int y0, int y1) {
+    double rF = (v.maxRe - v.minRe) / double(v.width - 1);
+    double iF = (v.maxIm - v.minIm) / double(v.height - 1);
+
+    uint64_t work = 0;
+    for (int y = y0; y < y1; ++y) {
+        Real im = Real(row_im(v, iF, y));
+        size_t row = size_t(y - y0) * v.width;
+        for (int x = 0; x < v.width; ++x) {
+            Real re = Real(col_re(v, rF, x));
+            double d;
+            int n = F::julia ? iterate_de<F>(re, im, Real(v.cRe), Real(v.cIm), v.maxIter, d)
+                             : iterate_de<F>(Real(0), Real(0), re, im, v.maxIter, d);
+            if (iters) iters[row + x] = uint32_t(n);
+            de[row + x] = float(d);
+            work += uint64_t(n);
+        }
+    }
+    if (iteration_count) *iteration_count += work;
+}
+
+// line art from a distance estimate: black inside and on the boundary, fading to
+// white over about two pixels, so filaments thinner than a pixel still show
+inline uint32_t line_value(float de, double pixel) {
+    if (de < 0.0f) return 0xFF000000u;
+    double t = std::min(1.0, double(de) / (2.0 * pixel));
+    uint8_t s = uint8_t(255.0 * std::sqrt(t) + 0.5);
+    return (255u << 24) | (s << 16) | (s << 8) | s;
+}
+
+// ---- threading ---------------------------------------------------------------
+
+// Hook for per-worker figures (benchmark, metrics). While set (from one thread, around a
+// render), split_rows calls slices(n) before starting n workers, then begin(i) and
+// end(i) on the worker running slice i, around fn. Slices are not nested anywhere,
+// so i is the worker.
+struct SliceProbe {
+    virtual ~SliceProbe() = default;
+    virtual void slices(int n) = 0;
+    virtual void begin(int i) = 0;
+    virtual void end(int i) = 0;
+};
+inline SliceProbe* slice_probe = nullptr;
+
+// runs fn(a, b) for slices of [y0, y1) on threadCount threads (0 = all cores)
+// (each slice is a trace span, see trace.h)
+template <class Fn>
+void split_rows(int y0, int y1, int threadCount, Fn fn) {
+    int nThreads = threadCount > 0 ? threadCount : int(std::thread::hardware_concurrency());
+    if (nThreads <= 0) nThreads = 4;
+
+    int rows     = y1 - y0;
+    int rowsPer  = std::max(1, rows / nThreads);
+
+    SliceProbe* probe = slice_probe;
+    if (probe) probe->slices(nThreads);
+    auto slice = [=](int i, int a, int b) {
+        trace::Span span("threads", "slice", a, b);
+        if (probe) probe->begin(i);
+        fn(a, b);
+        if (probe) probe->end(i);
+    };
+
+    if (nThreads == 1 || rows <= 1) {
+        slice(0, y0, y1);
+    } else {
+        std::vector<std::thread> pool;
+        pool.reserve(nThreads);
+        for (int i = 0; i < nThreads; ++i) {
+            int a = y0 + i * rowsPer;
+            int b = (i + 1 == nThreads ? y1 : a + rowsPer);
+            if (a >= y1) break;
+            pool.emplace_back([=]() { slice(i, a, b); });
+        }
+        for (auto &th : pool) th.join();
+    }
+}
+
+// ---- runtime selection ---------------------------------------------------------
+
+enum class Formula { Mandelbrot, Multibrot3, Multibrot4, BurningShip, Tricorn };
+enum class Precision { Double, Float };
+
+inline const char* formula_name(Formula f) {
+    switch (f) {
+    case Formula::Multibrot3:  return "multibrot3";
+    case Formula::Multibrot4:  return "multibrot4";
+    case Formula::BurningShip: return "burningship";
+    case Formula::Tricorn:     return "tricorn";
+    default:                   return "mandelbrot";
+    }
+}
+
+inline bool parse_formula(const std::string& s, Formula& out) {
+    for (Formula f : { Formula::Mandelbrot, Formula::Multibrot3, Formula::Multibrot4,
+                       Formula::BurningShip, Formula::Tricorn })
+        if (s == formula_name(f)) { out = f; return true; }
+    return false;
+}
+
+// compile-time (formula, real) pair handed to dispatch() callbacks
+template <class F, class Real>
+struct Kernel {
+    using formula = F;
+    using real    = Real;
+};
+
+// calls fn(Kernel<F, Real>{}) for the runtime choice; julia wraps F in JuliaOf
+template <class Fn>
+inline void dispatch(Formula f, Precision p, bool julia, Fn&& fn) {
+    auto pick = [&](auto tag) {
+        using F = typename decltype(tag)::formula;
+        if (julia) {
+            if (p == Precision::Float) fn(Kernel<JuliaOf<F>, float>{});
+            else                       fn(Kernel<JuliaOf<F>, double>{});
+        } else {
+            if (p == Precision::Float) fn(Kernel<F, float>{});
+            else                       fn(Kernel<F, double>{});
+        }
+    };
+    switch (f) {
+    case Formula::Multibrot3:  pick(Kernel<Multibrot<3>, void>{}); break;
+    case Formula::Multibrot4:  pick(Kernel<Multibrot<4>, void>{}); break;
+    case Formula::BurningShip: pick(Kernel<BurningShip,  void>{}); break;
+    case Formula::Tricorn:     pick(Kernel<Tricorn,      void>{}); break;
+    default:                   pick(Kernel<Mandelbrot,   void>{}); break;
+    }
+}
+
+// whether f has a distance estimate (analytic formulas)
+inline bool has_distance(Formula f) {
+    bool r = false;
+    dispatch(f, Precision::Double, false, [&](auto k) { r = decltype(k)::formula::analytic; });
+    return r;
+}
+
+} // namespace escape
+
+#endif
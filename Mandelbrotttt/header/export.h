@@ -0,0 +1,33 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <string>
+#include "escape.h"
+
+// Out-of-core render: the image is computed in horizontal bands and each band
+// is streamed straight to the output, so memory stays at a few bands no matter
+// how big width x height gets.
+//   *.png         -> streamed PngWriter (same orientation as save_png_from_buffer)
+//   *.qoi         -> streamed QoiWriter (ditto)
+//   *.itf         -> iteration field (field.h), for --recolor later
+//   anything else -> raw ARGB8888, top row first, no header
+struct ExportOptions {
+    int  width   = 720;
+    int  height  = 480;
+    std::string path;
+    bool mmap     = false; // raw only: render bands directly into a memory-mapped file
+    int  bandRows = 0;     // rows per band, 0 = auto (~64 MB per band)
+    int  threads  = 0;     // 0 = hardware_concurrency()
+    bool smooth   = false; // itf only: float smooth values instead of iteration counts
+    bool compress = false; // itf only: delta/varint rows (not mappable as one array)
+    int  aa       = 0;     // colour outputs: adaptive supersampling grid (e.g. 4 = 4x4), 0/1 = off
+    int  aaThreshold = 2;  // refine pixels whose iterations differ from a neighbour by more than this
+    double aaDe   = 0.0;   // > 0: refine by distance estimate instead, within this many pixels of the set
+    bool de       = false; // colour outputs: distance-estimate line art instead of the gray view
+    escape::Formula   formula   = escape::Formula::Mandelbrot;
+    escape::Precision precision = escape::Precision::Double;
+};
+
+int run_export(const ExportOptions& opt);
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef FIELD_H
+#define FIELD_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/*
+Iteration-field files (*.itf): the escape-time result of a render before it
+is coloured, so palettes can be tried later without recomputing (--recolor).
+
+Layout, little-endian:
+  FieldHeader, 128 bytes
+  raw        : width*height samples at dataOffset, row-major, top row first.
+               Can be used straight from the mapping (FieldReader::samples()).
+  compressed : the rows one after another at dataOffset, then height+1 uint64
+               row offsets (relative to dataOffset) at indexOffset. A row is the
+               sample bits delta-coded against the left neighbour, zigzag + LEB128.
+Samples are uint32 iteration counts or float smooth values; maxIter = inside.
+*/
+
+enum FieldSample : uint32_t {
+    FIELD_ITER_U32   = 0,
+    FIELD_SMOOTH_F32 = 1,
+};
+
+enum FieldCompression : uint32_t {
+    FIELD_RAW          = 0,
+    FIELD_DELTA_VARINT = 1,
+};
+
+struct FieldHeader {
+    char     magic[4];        // "ITF1"
+    uint32_t headerSize;      // sizeof(FieldHeader)
+    uint32_t width, height;
+    uint32_t sample;          // FieldSample
+    uint32_t compression;     // FieldCompression
+    int32_t  maxIter;
+    uint32_t fractal;         // bit 0: Julia set; bits 1..: escape::Formula (0 = Mandelbrot)
+    double   minRe, maxRe, minIm, maxIm;
+    double   cRe, cIm;        // Julia constant, 0 for Mandelbrot
+    uint64_t dataOffset;
+    uint64_t dataSize;
+    uint64_t indexOffset;     // compressed only
+    uint8_t  reserved[24];
+};
+static_assert(sizeof(FieldHeader) == 128, "FieldHeader layout is part of the file format");
+
+// Streams rows into a field file; fill width/height/sample/compression/viewport in meta
+class FieldWriter {
+public:
+    FieldWriter(const std::string& path, const FieldHeader& meta);
+    ~FieldWriter();
+
+    // count rows of 4-byte samples, top row first
+    bool write_rows(const void* rows, int count);
+    bool finish();
+
+    bool ok() const { return good; }
+
+private:
+    std::FILE* f;
+    FieldHeader hdr;
+    bool good;
+    int  rowsDone;
+    std::vector<uint64_t> rowOffsets;
+    std::vector<uint8_t>  enc;
+};
+
+// Memory-maps a field file read-only
+class FieldReader {
+public:
+    explicit FieldReader(const std::string& path);
+    ~FieldReader();
+
+    bool ok() const { return base != nullptr; }
+    const FieldHeader& header() const { return *reinterpret_cast<const FieldHeader*>(base); }
+
+    // raw files only (nullptr otherwise): the whole sample array, straight from the mapping
+    const void* samples() const;
+    // rows [y0, y1) as 4-byte samples into dst, decoding if compressed
+    bool read_rows(int y0, int y1, void* dst) const;
+
+private:
+    const uint8_t* base = nullptr;
+    uint64_t size = 0;
+#ifdef _WIN32
+    void* file = nullptr;
+    void* map  = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+#endif
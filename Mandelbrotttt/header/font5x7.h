@@ -3,7 +3,6 @@
 
 #include <cstdint>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 /*
@@ -14,8 +13,14 @@ struct Glyph5x7 {
     uint8_t rows[7];
 };
 
-inline const std::unordered_map<char, Glyph5x7>& font5x7() {
-    static const std::unordered_map<char, Glyph5x7> F = {
+struct Font5x7 {
+    Glyph5x7 glyph[128];    // by ASCII code
+};
+
+// Lookup table for draw_text_rgba, built once: lowercase letters use the uppercase
+// glyphs, anything without a glyph is blank
+inline const Font5x7& font5x7() {
+    static const struct { char c; Glyph5x7 g; } list[] = {
         {' ', {{0,0,0,0,0,0,0}}},
         {'0', {{0x1E,0x11,0x13,0x15,0x19,0x11,0x1E}}},
         {'1', {{0x04,0x0C,0x04,0x04,0x04,0x04,0x1F}}},
@@ -54,40 +59,46 @@ inline const std::unordered_map<char, Glyph5x7>& font5x7() {
         {'W', {{0x11,0x11,0x11,0x11,0x15,0x1B,0x11}}},
         {'X', {{0x11,0x11,0x0A,0x04,0x0A,0x11,0x11}}},
         {'Y', {{0x11,0x11,0x0A,0x04,0x04,0x04,0x04}}},
-        {'G', {{0x0E,0x11,0x10,0x10,0x10,0x11,0x0E}}},
+        {'G', {{0x0E,0x11,0x10,0x17,0x11,0x11,0x0F}}},
+        {'J', {{0x07,0x02,0x02,0x02,0x02,0x12,0x0C}}},
+        {'Q', {{0x0E,0x11,0x11,0x11,0x15,0x12,0x0D}}},
+        {'Z', {{0x1F,0x01,0x02,0x04,0x08,0x10,0x1F}}},
+        {'/', {{0x01,0x01,0x02,0x04,0x08,0x10,0x10}}},
+        {'%', {{0x18,0x19,0x02,0x04,0x08,0x13,0x03}}},
+        {'+', {{0x00,0x04,0x04,0x1F,0x04,0x04,0x00}}},
+        {'=', {{0x00,0x00,0x1F,0x00,0x1F,0x00,0x00}}},
+        {',', {{0x00,0x00,0x00,0x00,0x06,0x02,0x04}}},
     };
+    static const Font5x7 F = [] {
+        Font5x7 f{};
+        for (const auto& e : list) f.glyph[int(e.c)] = e.g;
+        for (int c = 'a'; c <= 'z'; ++c) f.glyph[c] = f.glyph[c - 'a' + 'A'];
+        return f;
+    }();
     return F;
 }
 
 inline void draw_text_rgba(uint32_t* pix, int W, int H, int x, int y,
                            const std::string& txt, uint32_t color = 0xFFFFFFFFu, int scale = 2)
 {
-    const auto& F = font5x7();
+    const Font5x7& F = font5x7();
     int cx = x, cy = y;
     for (char ch : txt) {
         if (ch == '\n') {
             cy += 8 * scale; cx = x; continue;
         }
-        auto it = F.find(ch);
-        const Glyph5x7* g = nullptr;
-        if (it != F.end()) g = &it->second;
-        else {
-            auto it2 = F.find(' ');
-            if (it2 != F.end()) g = &it2->second;
-        }
-        if (g) {
-            for (int row = 0; row < 7; ++row) {
-                uint8_t bits = g->rows[row];
-                for (int col = 0; col < 5; ++col) {
-                    if (bits & (1 << (4 - col))) {
-                        for (int yy = 0; yy < scale; ++yy) {
-                            int py = cy + row*scale + yy;
-                            if (py < 0 || py >= H) continue;
-                            for (int xx = 0; xx < scale; ++xx) {
-                                int px = cx + col*scale + xx;
-                                if (px < 0 || px >= W) continue;
-                                pix[py * W + px] = color;
-                            }
+        const Glyph5x7& g = F.glyph[uint8_t(ch) < 128 ? uint8_t(ch) : ' '];
+        for (int row = 0; row < 7; ++row) {
+            uint8_t bits = g.rows[row];
+            for (int col = 0; col < 5; ++col) {
+                if (bits & (1 << (4 - col))) {
+                    for (int yy = 0; yy < scale; ++yy) {
+                        int py = cy + row*scale + yy;
+                        if (py < 0 || py >= H) continue;
+                        for (int xx = 0; xx < scale; ++xx) {
+                            int px = cx + col*scale + xx;
+                            if (px < 0 || px >= W) continue;
+                            pix[py * W + px] = color;
                         }
                     }
                 }
@@ -2,35 +2,114 @@
 #define GUI_H
 
 #include <SDL3/SDL.h>
+#include <atomic>
 #include <string>
+#include <future>
+#include <vector>
 #include "mandelbrot.h"
 #include "julia.h"
+#include "latency.h"
 
 class Gui {
 public:
-    Gui(int w, int h, bool useGPU, bool useSingle);
+    Gui(int w, int h, bool useSingle, bool refine = true);
     ~Gui();
 
     int run();
 
+    // formula / precision for both views (F cycles the formula at runtime)
+    void setFormula(escape::Formula f, escape::Precision p);
+    // also write the input latency histogram to path on exit (see latency.h)
+    void setLatencyOut(const std::string& path) { latencyOut = path; }
+
 private:
     SDL_Window*   window   = nullptr;
     SDL_Renderer* renderer = nullptr;
     SDL_Texture*  texture  = nullptr;
 
     int  width, height;
-    bool useGPU;
     bool useSingle;
     bool showJulia = false;
+    bool refine;            // idle-time progressive anti-aliasing (Mandelbrot view)
 
     Fractal mandel;
     Julia   julia;
 
+    // image saves run in the background against a snapshot of the buffer,
+    // one after another (each job waits for the previous one)
+    std::shared_future<void> lastSave;
+
+    // Progressive refinement: while there's no input, jittered samples of the current
+    // view are summed into accum and the average is shown every refinePresentMs.
+    // Any view change throws the accumulation away.
+    static constexpr int refineMaxSamples = 64;
+    static constexpr int refineIdleMs     = 250;   // quiet time before refining starts
+    static constexpr int refinePresentMs  = 300;
+    static constexpr int refineSliceMs    = 8;     // keeps the event loop responsive
+    std::vector<float>    accum;      // RGB sums
+    std::vector<uint32_t> sampleBuf;  // one jittered pass (band-local)
+    std::vector<uint32_t> shown;      // averaged frame
+    int    accumSamples = 0;
+    int    refineRow    = 0;
+    int    refineBand   = 16;
+    Uint64 lastInput    = 0;
+    Uint64 lastPresent  = 0;
+
+    // Julia explorer (J): over the Mandelbrot view the cursor picks the Julia constant.
+    // A coarse preview of that Julia set is drawn in an inset every exploreFrameMs while
+    // the cursor moves; once it rests for exploreRestMs the inset is rendered at full
+    // inset resolution on a worker thread, cancelled by the next event.
+    static constexpr int exploreFrameMs = 16;
+    static constexpr int exploreRestMs  = 150;
+    static constexpr int insetDiv       = 4;   // inset = window / insetDiv
+    static constexpr int coarseDiv      = 3;   // moving preview = inset / coarseDiv
+    bool   explore      = false;
+    bool   previewDirty = false;  // c changed since the last coarse preview
+    bool   insetSharp   = true;   // full-res inset done or under way
+    int    insetW = 1, insetH = 1;
+    Uint64 lastMotion   = 0;
+    Uint64 lastPreview  = 0;
+    std::vector<uint32_t> insetPix;   // inset as shown
+    std::vector<uint32_t> insetFull;  // worker output
+    std::vector<uint32_t> coarse;
+    std::vector<uint32_t> framed;     // frame + inset
+    const uint32_t* frame = nullptr;  // last Mandelbrot frame presented
+    std::future<bool>  insetJob;
+    std::atomic<bool>  insetCancel{false};
+
+    // Performance HUD (H): the last frame's compute and upload time, Miter/s, threads,
+    // zoom, maxIter and share of reused pixels (metrics::last()), drawn into its own
+    // small texture over the frame, so the frame buffers aren't touched
+    static constexpr int hudScale = 2;
+    static constexpr int hudLines = 7;
+    static constexpr int hudW = 18 * 6 * hudScale + 12;          // 18 columns
+    static constexpr int hudH = hudLines * 8 * hudScale + 10;
+    bool   showHud  = false;
+    double uploadMs = 0.0;    // last SDL_UpdateTexture of the frame
+    SDL_Texture* hudTex = nullptr;
+    std::vector<uint32_t> hudPix;
+
+    // Input-to-photon latency: inputAt is the timestamp of the key / wheel event being
+    // handled, and the first present() after it records the frame; events that don't
+    // lead to a frame (saves, toggles of hidden modes) aren't counted. Printed on exit.
+    LatencyStats latency;
+    Uint64 inputAt = 0;
+    std::string latencyOut;
+
     bool initSDL();
+    bool exploreStep();
+    void cancelInset();
+    bool refineStep();
+    void resetRefine();
+    void present(const uint32_t* pix);
+    void drawHud();
     void handleEvent(const SDL_Event& e);
     void renderCurrent();
     void saveBMP(const std::string& fn);
     void savePNG(const std::string& fn);
+    void saveQOI(const std::string& fn);
+    void saveAsync(void (*writer)(const uint32_t*, int, int, const std::string&),
+                   const std::string& path);
 };
 
 #endif
@@ -3,12 +3,84 @@
 
 #include <SDL3/SDL.h>
 #include <cstdint>
+#include <cstdio>
 #include <string>
+#include <vector>
 
 // void save_bmp_from_texture(SDL_Renderer* renderer, SDL_Texture* tex, int w, int h);
 // void save_png_from_texture(SDL_Renderer* renderer, SDL_Texture* tex, int w, int h);
 
+// PNG encoder settings (parallel writer, see image_save.cpp)
+//   level    : 0 = stored (no compression), 1..9 = match search effort
+//   filter   : -1 = pick per row (min abs-sum, same heuristic as stb),
+//              0..4 = force None/Sub/Up/Average/Paeth
+//   threads  : 0 = hardware_concurrency()
+//   bandRows : rows per independently deflated band, 0 = auto
+struct PngOptions {
+    int level    = 6;
+    int filter   = -1;
+    int threads  = 0;
+    int bandRows = 0;
+};
+
+// Defaults used by save_png_from_buffer(pixels, w, h, path); main.cpp fills it from the CLI
+PngOptions& png_options();
+
+// Streaming PNG encoder. Rows are pushed in file order (top row of the file
+// first) and compressed in parallel bands; only one batch of bands is held in
+// memory at a time, so the image never has to exist as a whole.
+class PngWriter {
+public:
+    PngWriter(const std::string& path, int w, int h, const PngOptions& opt = png_options());
+    ~PngWriter();
+
+    // count rows starting at first; rowStep = pixels from one row to the next
+    // (negative walks the buffer bottom-up)
+    bool write_rows(const uint32_t* first, int count, long long rowStep);
+    // writes the trailer; false if anything failed or not all rows arrived
+    bool finish();
+
+    bool ok() const { return good; }
+
+private:
+    std::FILE* f;
+    int  width, height;
+    PngOptions opt;
+    int  nThreads, bandRows;
+    bool good;
+    int  rowsDone;
+    uint32_t adler;
+    std::vector<uint8_t> prevRow;   // RGBA of the last row written (filter context)
+};
+
+// Streaming QOI encoder (fast lossless), same row-feeding contract as PngWriter.
+class QoiWriter {
+public:
+    QoiWriter(const std::string& path, int w, int h);
+    ~QoiWriter();
+
+    bool write_rows(const uint32_t* first, int count, long long rowStep);
+    bool finish();
+
+    bool ok() const { return good; }
+
+private:
+    std::FILE* f;
+    int  width, height;
+    bool good;
+    uint64_t pixelsDone;
+    int  run;
+    uint32_t prev;
+    uint32_t index[64];
+    std::vector<uint8_t> out;   // write buffer
+
+    void flush_out();
+};
+
 void save_bmp_from_buffer(const uint32_t* pixels, int w, int h, const std::string& path);
 void save_png_from_buffer(const uint32_t* pixels, int w, int h, const std::string& path);
+void save_png_from_buffer(const uint32_t* pixels, int w, int h, const std::string& path,
+                          const PngOptions& opt);
+void save_qoi_from_buffer(const uint32_t* pixels, int w, int h, const std::string& path);
 
-#endif
\ No newline at end of file
+#endif
@@ -7,18 +7,57 @@
 #ifndef JULIA_H
 #define JULIA_H
 
+#include <atomic>
 #include <cstdint>
 #include <vector>
-#include <SDL3/SDL.h>
+#include "escape.h"
 
 class Julia {
 public:
+    static constexpr int maxIter = 500;
+
     Julia(int width, int height);
 
-    void render(SDL_Renderer* rend, SDL_Texture* tex);
+    // the current mode (distance, line art or the normal view) into the pixel buffer;
+    // threadCount: 0 = hardware_concurrency(), 1 = single-threaded
+    void update(int threadCount = 0);
+    // Headless path: compute into the pixel buffer only (timed, like Fractal::compute_only)
+    void compute_only(int threadCount = 0);
+    // the same work, silent; true if the bottom half was mirrored
+    bool compute(int threadCount = 0);
+    // Same, but escape counts (maxIter = inside) into iters (width*height)
+    bool compute_field(uint32_t* iters, int threadCount = 0) const;
+    // Reduced-resolution path for previews: the current view sampled on a w x h grid
+    // into dst. Checks *cancel between rows and returns false if it was set.
+    bool compute_preview(uint32_t* dst, int w, int h, int threadCount = 0,
+                         const std::atomic<bool>* cancel = nullptr) const;
+    // Boundary-only render by the modified inverse iteration method (z^2 + c only):
+    // walks the preimage tree z -> +-sqrt(z - c) from the repelling fixed point and
+    // stops a branch once its pixel has been hit hitLimit times, so the cost follows
+    // the boundary length, not the area. Black line art on white into the pixel
+    // buffer. The tree is walked one level at a time with one shared hit grid, so the
+    // work and the image don't depend on the thread count. False (buffer untouched)
+    // for other formulas.
+    bool compute_boundary(int hitLimit = 8, int threadCount = 0);
+    // update() uses compute_boundary instead of compute_only while on
+    void setBoundary(bool on, int hitLimit = 8) { boundary = on; boundaryHits = hitLimit; }
+    bool getBoundary() const { return boundary; }
+
+    // Distance-estimate line art (escape::line_value) into the pixel buffer, timed.
+    // False (buffer untouched) for Burning Ship / Tricorn.
+    bool compute_distance(int threadCount = 0);
+    // update() uses compute_distance while on (before the boundary mode)
+    void setDistance(bool on) { distance = on; }
+    bool getDistance() const { return distance; }
+
     void setConstant(double cre, double cim);
+    // formula whose Julia set is drawn (Mandelbrot = the classic z^2 + c)
+    void setFormula(escape::Formula f) { formula = f; }
+    void setPrecision(escape::Precision p) { precision = p; }
 
     const uint32_t* data() const { return pixels.data(); }
+    // current view as the engine sees it (size, limit, constant)
+    escape::View view() const;
 
     double minRe, maxRe, minIm, maxIm;
     double reFactor, imFactor;
@@ -30,9 +69,18 @@ private:
     int width, height;
     std::vector<uint32_t> pixels;
     double c_re, c_im;
+    escape::Formula   formula   = escape::Formula::Mandelbrot;
+    escape::Precision precision = escape::Precision::Double;
+    bool distance     = false;
+    bool boundary     = false;
+    int  boundaryHits = 8;
 
     void updateFactors();
-    static uint32_t mapColor(int iter, int maxIter);
+    // view centred on 0, so pixel (x, y) and (w-1-x, h-1-y) are z and -z
+    bool centred() const;
+    // full view with colouring Color into dst, using the point symmetry when it can
+    template <class Color>
+    bool render_symmetric(typename Color::Out* dst, int threadCount) const;
 };
 
 #endif
@@ -0,0 +1,50 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Log-linear latency histogram in the style of HdrHistogram: values below 256 get
+// a bucket each, above that every power of two is split into 128 buckets, so any
+// value is reported within 0.8% over the whole uint64 range, in ~60 KB and O(1) per
+// record. Units are up to the caller (the viewer records microseconds).
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record(uint64_t v);
+    uint64_t count() const { return n; }
+    uint64_t max() const { return hi; }
+    double   mean() const { return n ? double(sum) / double(n) : 0.0; }
+    // value at or below which p % of the samples fall (the bucket's upper edge,
+    // capped at max()); 0 when empty
+    uint64_t percentile(double p) const;
+    // (upper edge, count) of every non-empty bucket
+    std::vector<std::pair<uint64_t, uint64_t>> buckets() const;
+
+private:
+    static constexpr int subBits = 8;
+    static constexpr int sub     = 1 << subBits;
+    std::vector<uint64_t> counts;
+    uint64_t n = 0, sum = 0, hi = 0;
+
+    static int index(uint64_t v);
+    static uint64_t upper(int i);
+};
+
+// Input-to-photon latency of the viewer: from the timestamp of a key / wheel event
+// to the SDL_RenderPresent of the frame it caused, split into compute (event to
+// pixels ready, queueing included), upload (SDL_UpdateTexture) and present.
+struct LatencyStats {
+    LatencyHistogram total, compute, upload, present;
+
+    // all in SDL_GetTicksNS() nanoseconds
+    void record(uint64_t input, uint64_t ready, uint64_t uploaded, uint64_t presented);
+    // p50 / p99 / max per stage to stdout (nothing if no frame was recorded)
+    void print() const;
+    // the same as JSON, plus the total's buckets; false if the file can't be written
+    bool write(const std::string& path) const;
+};
+
+#endif
@@ -1,27 +1,76 @@
 #ifndef MANDELBROT_H
 #define MANDELBROT_H
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
-#include <SDL3/SDL.h>
+#include "escape.h"
 
 class Fractal {
 public:
-    Fractal(int width, int height);
+    static constexpr int defaultMaxIter = 500;
 
-    // GUI
-    void render_cpu(SDL_Renderer* r, SDL_Texture* t, int threadCount = 0);
-    void render_gpu(SDL_Renderer* r, SDL_Texture* t); // stub -> CPU
+    // allocate = false skips the width*height pixel buffer (band/export use only;
+    // compute_only needs it)
+    Fractal(int width, int height, bool allocate = true);
 
-    // Benchmark path: compute only (no GUI)
+    // Benchmark path: compute only (no GUI), timed and logged
     void compute_only(int threadCount = 0);
+    // the same work, silent (what benchmarks time)
+    void compute(int threadCount = 0);
+
+    // Export path: rows [y0, y1) of the current view into dst (band-local, (y1-y0)*width)
+    void compute_rows(uint32_t* dst, int y0, int y1, int threadCount = 0) const;
+    // Same, but the uncoloured result: iteration counts (maxIter = inside) and/or
+    // smooth values n + 1 - log_d(log|z|). Either pointer may be null.
+    void compute_field(uint32_t* iters, float* smooth, int y0, int y1, int threadCount = 0) const;
+    // Adaptive anti-aliasing: one sample per pixel first, then pixels whose iteration
+    // count differs from a neighbour's by more than threshold get grid x grid samples,
+    // averaged. Returns how many pixels were refined.
+    size_t compute_rows_aa(uint32_t* dst, int y0, int y1, int grid, int threshold,
+                           int threadCount = 0) const;
+    // Distance-estimate line art of rows [y0, y1): black boundary on white, see
+    // escape::line_value. False (dst untouched) for Burning Ship / Tricorn.
+    bool compute_rows_de(uint32_t* dst, int y0, int y1, int threadCount = 0) const;
+    // compute_rows_aa steered by the distance estimate instead: only pixels outside
+    // the set within radius pixel-widths of it, and inside pixels next to an outside
+    // one, get grid x grid samples. Falls back to compute_rows_aa(threshold 2) for
+    // formulas without one.
+    size_t compute_rows_aa_de(uint32_t* dst, int y0, int y1, int grid, double radius,
+                              int threadCount = 0) const;
+    // compute_rows with every sample moved by (jx, jy) pixels, for progressive refinement
+    void compute_rows_jittered(uint32_t* dst, int y0, int y1, double jx, double jy,
+                               int threadCount = 0) const;
+
+    // iteration formula / arithmetic / limit used by every compute_* path
+    void setFormula(escape::Formula f) { formula = f; orbitsValid = false; }
+    escape::Formula getFormula() const { return formula; }
+    void setPrecision(escape::Precision p) { precision = p; orbitsValid = false; }
+    void setMaxIter(int n) { maxIter = n; orbitsValid = false; }
+    int  getMaxIter() const { return maxIter; }
+
+    // Resumable iterations: with keepOrbits on, compute_only also keeps every pixel's
+    // escape count and last z (24 bytes/pixel). raise_max_iter then continues only
+    // the pixels that hadn't escaped, from where they stopped, and recolours the
+    // frame; the result is the same as a full render at the new limit. Without a
+    // state for the current view (or when lowering the limit) it renders in full
+    // and returns false.
+    void setKeepOrbits(bool on) { keepOrbits = on; if (!on) { orbits.clear(); orbits.shrink_to_fit(); orbitsValid = false; } }
+    bool raise_max_iter(int newMax, int threadCount = 0);
+    // escape counts of the kept orbits into iters (width*height); false if there
+    // is no state for the current view
+    bool orbit_counts(uint32_t* iters) const;
 
     void zoomAt(int mx, int my, int dir);
     void pan(int dx, int dy);
     void reset();
+    // view centred on (cre, cim), spanRe wide, height from the aspect ratio
+    void setView(double cre, double cim, double spanRe);
 
     const uint32_t* data() const { return pixels.data(); }
     uint32_t* data_mut() { return pixels.data(); }
+    // current view as the engine sees it (size, limit)
+    escape::View view() const;
 
     // current viewport & factors
     double minRe, maxRe, minIm, maxIm;
@@ -31,14 +80,40 @@ private:
     int width, height;
     std::vector<uint32_t> pixels;
 
+    escape::Formula   formula   = escape::Formula::Mandelbrot;
+    escape::Precision precision = escape::Precision::Double;
+    int maxIter = defaultMaxIter;
+
+    bool keepOrbits  = false;
+    bool orbitsValid = false;   // orbits matches the current view/formula/limit
+    std::vector<escape::OrbitPoint> orbits;
+
     void update_factors();
-    void clear_and_present(SDL_Renderer* r, SDL_Texture* t);
+    void compute_orbits(int threadCount);
+    void colour_from_orbits();
 
-    static void render_section(uint32_t* pix,
-                               int w, int h,
-                               double minR, double maxR,
-                               double minI, double maxI,
-                               int y0, int y1);
+    // row S such that rows y and S - y sit at conjugate heights; false if the
+    // real axis doesn't fall on the pixel grid
+    bool mirror_row_sum(int& S) const;
+    // rows [m0, m1) of [y0, y1) that mirror rows S - y inside the range; false if none
+    bool mirror_range(int y0, int y1, int& m0, int& m1, int& S) const;
+    // rows a full render copies across the real axis instead of iterating
+    int mirrored_rows() const;
+    // bytes held in pixel / orbit buffers
+    size_t buffer_bytes() const;
+    // engine kernel for the current formula/precision with colouring Color,
+    // rows [y0, y1) into dst (band-local)
+    template <class Color>
+    void run_kernel(typename Color::Out* dst, int y0, int y1, int threadCount,
+                    double jx = 0.0, double jy = 0.0) const;
+    // distance estimates (and escape counts, if iters) of rows [y0, y1); false if the
+    // formula has none
+    bool distance_field(uint32_t* iters, float* de, int y0, int y1, int threadCount) const;
+    // AA pass 2: rows [y0, y1) into dst from the pass-1 counts iters (starting at row
+    // h0), grid x grid samples where need(x, y) says so; returns how many
+    template <class Need>
+    size_t supersample_rows(uint32_t* dst, int y0, int y1, int grid, const uint32_t* iters,
+                            int h0, int threadCount, Need need) const;
 };
 
 #endif
@@ -0,0 +1,86 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "escape.h"
+
+// Per-frame render metrics. The timed entry points (Fractal::compute_only and
+// raise_max_iter, Julia::compute_only / compute_distance / compute_boundary) each
+// record one Frame. The last frame and running totals can be queried in-process;
+// with a log open every frame is appended as a JSON line, plus a totals line
+// every intervalMs. Nothing goes to the console unless `console` is set.
+namespace metrics {
+
+struct Frame {
+    uint64_t    seq     = 0;
+    const char* source  = "";   // "mandelbrot", "resume", "julia", "julia-distance", "julia-boundary"
+    double      wallMs  = 0.0;
+    int         threads = 0;
+    std::vector<double> busyMs; // per split_rows worker, summed over the frame
+    uint64_t iterations  = 0;   // escape-loop steps (render_rows and the resume loop)
+    uint64_t computed    = 0;   // pixels iterated this frame
+    uint64_t reused      = 0;   // pixels copied across a symmetry or kept from the last frame
+    size_t   bufferBytes = 0;   // pixel / orbit / scratch buffers the frame used
+};
+
+struct Totals {
+    uint64_t frames = 0;
+    double   wallMs = 0.0, maxWallMs = 0.0;
+    uint64_t iterations = 0, computed = 0, reused = 0;
+    size_t   peakBufferBytes = 0;
+};
+
+inline bool console = false;    // --verbose: one summary line per frame on stdout
+
+Frame  last();                  // seq 0 before the first frame
+Totals totals();
+
+// JSON lines log (appends); false if the file can't be opened
+bool open_log(const std::string& path, int intervalMs = 0);
+void close_log();               // writes a final totals line
+
+// Times one frame from construction to finish(). While it is alive, split_rows
+// workers report their busy time to it and render_rows its iterations, unless
+// someone else (the benchmark) already installed escape::slice_probe /
+// iteration_count. Frames on one thread only: the viewer and the headless paths
+// don't render concurrently.
+class FrameScope : public escape::SliceProbe {
+public:
+    FrameScope(const char* source, int threads);
+    ~FrameScope() override;
+    FrameScope(const FrameScope&) = delete;
+    FrameScope& operator=(const FrameScope&) = delete;
+
+    // iterations counted outside render_rows go in extraIterations
+    void finish(uint64_t computed, uint64_t reused, size_t bufferBytes,
+                uint64_t extraIterations = 0);
+
+    void slices(int n) override;
+    void begin(int i) override;
+    void end(int i) override;
+
+private:
+    using Clock = std::chrono::steady_clock;
+    Frame frame;
+    Clock::time_point t0;
+    std::vector<Clock::time_point> sliceT0;
+    std::atomic<uint64_t> iters{0};
+    bool ownsProbe = false, ownsCount = false, done = false;
+};
+
+// Opens the log for its lifetime (nothing if path is empty); main() keeps one for --metrics.
+struct LogFile {
+    LogFile(const std::string& path, int intervalMs) { if (!path.empty()) open_log(path, intervalMs); }
+    ~LogFile() { close_log(); }
+    LogFile(const LogFile&) = delete;
+    LogFile& operator=(const LogFile&) = delete;
+};
+
+} // namespace metrics
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef PERFCOUNT_H
+#define PERFCOUNT_H
+
+#include <cstdint>
+#include <string>
+
+// Hardware counters via Linux perf_event_open, user space only. Counts the thread
+// that calls start() (and, with inherit, threads it starts afterwards). Events
+// that can't be opened (no PMU in a VM/container, perf_event_paranoid, not Linux)
+// just stay missing; everything else works as if no counters were asked for.
+class PerfCounters {
+public:
+    enum Event { Cycles, Instructions, BranchMisses, CacheMisses, EventCount };
+
+    explicit PerfCounters(bool inherit = false);
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const;             // at least one event open
+    const std::string& error() const { return why; }   // why an event failed ("" if none did)
+
+    void start();                       // reset + enable
+    void stop();                        // disable + read
+
+    bool has(Event e) const { return fd[e] >= 0; }
+    uint64_t value(Event e) const { return count[e]; }   // scaled if the PMU was multiplexed
+
+    static const char* name(Event e);   // "cycles", "instructions", ...
+
+private:
+    int fd[EventCount];
+    uint64_t count[EventCount];
+    std::string why;
+};
+
+// per-event sums over several start/stop windows
+struct PerfTotals {
+    double v[PerfCounters::EventCount] = {};
+    bool   has[PerfCounters::EventCount] = {};
+
+    void add(const PerfCounters& c);
+    void scale(double f);               // e.g. 1 / runs for per-frame values
+    double ipc() const;                 // instructions / cycles, 0 if either is missing
+};
+
+#endif
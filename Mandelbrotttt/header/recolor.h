@@ -0,0 +1,35 @@
+#ifndef RECOLOR_H
+#define RECOLOR_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Colour lookup for iteration / smooth values. Colouring a pixel is one
+// multiply + one table read, so recolouring a field is I/O-bound.
+//   gray  : same ramp as the Mandelbrot view
+//   julia : same bands as the Julia view
+//   fire, ocean : smooth gradients, one cycle every 64 iterations
+struct Palette {
+    std::vector<uint32_t> lut;
+    float    scale  = 1.0f;      // value -> lut index
+    bool     cyclic = false;     // wrap (else clamp) past the end of lut
+    uint32_t inside = 0xFF000000u;
+
+    static Palette make(const std::string& name, int maxIter);
+
+    uint32_t operator()(float v, int maxIter) const {
+        if (v >= float(maxIter)) return inside;
+        // smooth values go below 0 far out (and a hand-made field may hold anything),
+        // so clamp before the conversion; NaN goes to 0 as well
+        float t = v * scale;
+        size_t i = t > 0.0f ? size_t(t) : 0;
+        return lut[cyclic ? i % lut.size() : std::min(i, lut.size() - 1)];
+    }
+};
+
+// --recolor: reads an *.itf field (field.h) and writes OUT (.png or .qoi)
+int run_recolor(const std::string& in, const std::string& out, const std::string& palette);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <string>
+
+// Scoped trace spans, written as a Chrome trace-event file (chrome://tracing,
+// ui.perfetto.dev). Off by default: a Span then costs one relaxed atomic load.
+// While recording, each thread appends complete ("X") events to its own buffer;
+// buffers of finished threads are handed to the next new thread, so the short-
+// lived split_rows workers show up as a fixed set of rows instead of one per render.
+namespace trace {
+
+inline std::atomic<bool> recording{false};
+
+// starts recording (drops anything left from an earlier session); false if already on
+bool start(const std::string& path);
+// stops and writes the file given to start(); false if not recording or the write failed
+bool stop();
+bool active();
+// label (string literal) for the calling thread's row in the trace
+void name_thread(const char* name);
+
+// Times its own scope. name and cat must be string literals (stored by pointer);
+// y0 / y1 (rows, bands, ...) go into the event's args when y0 >= 0.
+class Span {
+public:
+    Span(const char* cat, const char* name, int y0 = -1, int y1 = -1) {
+        if (recording.load(std::memory_order_relaxed)) begin(cat, name, y0, y1);
+    }
+    ~Span() { if (t0 >= 0.0) end(); }
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    const char* cat  = nullptr;
+    const char* name = nullptr;
+    int    a = -1, b = -1;
+    int    session = 0;
+    double t0 = -1.0;   // microseconds since start(); < 0 = not recording
+
+    void begin(const char* c, const char* n, int y0, int y1);
+    void end();
+};
+
+// Records from construction to destruction into path (nothing if path is empty);
+// main() keeps one around for --trace.
+struct Session {
+    explicit Session(const std::string& path) { if (!path.empty()) start(path); }
+    ~Session() { if (active()) stop(); }
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+};
+
+} // namespace trace
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <string>
+#include "escape.h"
+
+// Golden-image check for the render paths: each viewport is rendered once with
+// the reference (escape::render_rows, double, one thread, no symmetry) and once
+// with every alternative engine, and the escape-count buffers are compared.
+//   viewports: full       default view (real axis on the pixel grid: mirrored)
+//              seahorse   0.03 wide, off the axis
+//              axis       0.25 wide on the axis left of the period-2 bulb, maxIter 1000
+//              deep       1e-9 wide, maxIter 2000
+//              julia      default Julia view (centred: point-mirrored)
+//              julia-off  the same, shifted off centre
+//   engines:   threads    Fractal/Julia compute path (threads + mirroring)
+//              bands      Fractal in 37-row bands (the export path)
+//              resume     Fractal at maxIter / 2, then raise_max_iter(maxIter)
+//              float      single precision (approximate; n/a where a float can't
+//                         resolve the pixel spacing)
+//              lanes4     iterate_streams, 4 lanes (Julia)
+// A pixel mismatches when its counts differ by more than tolerance. An engine
+// fails when more than maxMismatch % of pixels mismatch (floatMismatch % for
+// the approximate ones). Engines with any mismatch get a diff image in outDir.
+struct VerifyOptions {
+    int width   = 720;
+    int height  = 480;
+    int threads = 0;                // 0 = hardware_concurrency()
+    int tolerance = 0;              // allowed |count difference| per pixel
+    double maxMismatch   = 0.0;     // % of pixels, exact engines
+    double floatMismatch = 5.0;     // % of pixels, float engines
+    std::string scenes;             // comma-separated names, empty = all
+    std::string outDir = "img/verify";
+    escape::Formula formula = escape::Formula::Mandelbrot;
+};
+
+// 0 if every engine passed, 2 if one failed, 1 on errors
+int run_verify(const VerifyOptions& opt);
+
+#endif
@@ -1,8 +1,18 @@
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <cctype>
 #include "header/gui.h"
 #include "header/benchmark.h"
+#include "header/verify.h"
+#include "header/image_save.h"
+#include "header/export.h"
+#include "header/recolor.h"
+#include "header/atlas.h"
+#include "header/julia.h"
+#include "header/buddhabrot.h"
+#include "header/metrics.h"
+#include "header/trace.h"
 
 static bool is_number(const char* s) {
     if (!s || !*s) return false;
@@ -10,22 +20,185 @@ static bool is_number(const char* s) {
     return true;
 }
 
+static int parse_png_filter(const std::string& s) {
+    if (s == "none")  return 0;
+    if (s == "sub")   return 1;
+    if (s == "up")    return 2;
+    if (s == "avg")   return 3;
+    if (s == "paeth") return 4;
+    return -1; // auto
+}
+
+static bool ends_with(const std::string& s, const std::string& suf) {
+    return s.size() >= suf.size() && s.compare(s.size() - suf.size(), suf.size(), suf) == 0;
+}
+
+// Julia boundary line art (inverse iteration) of the default Julia view to path
+static int run_julia_boundary(const std::string& path, int w, int h, double cre, double cim,
+                              escape::Formula formula, int hitLimit, int threads) {
+    Julia julia(w, h);
+    julia.setConstant(cre, cim);
+    julia.setFormula(formula);
+    if (!julia.compute_boundary(hitLimit, threads)) {
+        std::cerr << "Julia boundary needs --formula mandelbrot\n";
+        return 1;
+    }
+    if (ends_with(path, ".qoi"))      save_qoi_from_buffer(julia.data(), w, h, path);
+    else if (ends_with(path, ".bmp")) save_bmp_from_buffer(julia.data(), w, h, path);
+    else                              save_png_from_buffer(julia.data(), w, h, path);
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
     std::cout << "Mandelbrotttt - Fractal Viewer\n";
 
     bool doBenchmark = false;
     bool useSingle   = false;
-    bool useGPU      = false;
+    bool refine      = true;
     int  width = 720, height = 480;
+    ExportOptions exportOpt;
+    AtlasOptions atlasOpt;
+    bool doAtlas = false;
+    BenchOptions benchOpt;
+    bool doKernelBench = false;
+    VerifyOptions verifyOpt;
+    bool doVerify = false;
+    BuddhaOptions buddhaOpt;
+    bool doBuddha = false;
+    std::string boundaryOut;
+    int    hitLimit = 8;
+    double juliaRe = -0.8, juliaIm = 0.156;
+    std::string recolorIn, recolorOut, palette = "gray";
+    std::string tracePath;
+    std::string metricsPath;
+    std::string latencyPath;
+    int metricsInterval = 0;
+    escape::Formula   formula   = escape::Formula::Mandelbrot;
+    escape::Precision precision = escape::Precision::Double;
 
     for (int i = 1; i < argc; ++i) {
         std::string a = argv[i];
         if (a == "--benchmark") {
             doBenchmark = true;
+        } else if (a == "--verify") {
+            doVerify = true;
+        } else if (a == "--verify-tolerance" && i + 1 < argc) {
+            verifyOpt.tolerance = std::max(0, std::stoi(argv[++i]));
+        } else if (a == "--verify-max-mismatch" && i + 1 < argc) {
+            verifyOpt.maxMismatch = std::stod(argv[++i]);
+        } else if (a == "--verify-float-mismatch" && i + 1 < argc) {
+            verifyOpt.floatMismatch = std::stod(argv[++i]);
+        } else if (a == "--verify-out" && i + 1 < argc) {
+            verifyOpt.outDir = argv[++i];
+        } else if (a == "--bench-kernels") {
+            doBenchmark = true;
+            doKernelBench = true;
+        } else if (a == "--benchmark-scaling") {
+            doBenchmark = true;
+            benchOpt.scaling = true;
+        } else if (a == "--bench-baseline" && i + 1 < argc) {
+            benchOpt.baseline = argv[++i];
+        } else if (a == "--bench-update-baseline") {
+            benchOpt.updateBaseline = true;
+        } else if (a == "--bench-threshold" && i + 1 < argc) {
+            benchOpt.threshold = std::stod(argv[++i]);
+        } else if (a == "--bench-perf") {
+            benchOpt.perf = true;
+        } else if (a == "--bench-reps" && i + 1 < argc) {
+            benchOpt.reps = std::max(1, std::stoi(argv[++i]));
+        } else if (a == "--bench-warmup" && i + 1 < argc) {
+            benchOpt.warmup = std::max(0, std::stoi(argv[++i]));
+        } else if (a == "--bench-scenes" && i + 1 < argc) {
+            benchOpt.scenes = argv[++i];
+        } else if (a == "--bench-threads" && i + 1 < argc) {
+            benchOpt.threads = std::stoi(argv[++i]);
+        } else if (a == "--bench-out" && i + 1 < argc) {
+            benchOpt.out = argv[++i];
         } else if (a == "--single") {
             useSingle = true;
         } else if (a == "--gpu") {
-            useGPU = true;
+            std::cerr << "--gpu: there is no GPU path, rendering on the CPU\n";
+        } else if (a == "--no-refine") {
+            refine = false;
+        } else if (a == "--png-level" && i + 1 < argc) {
+            png_options().level = std::clamp(std::stoi(argv[++i]), 0, 9);
+        } else if (a == "--png-filter" && i + 1 < argc) {
+            png_options().filter = parse_png_filter(argv[++i]);
+        } else if (a == "--export" && i + 1 < argc) {
+            exportOpt.path = argv[++i];
+        } else if (a == "--mmap") {
+            exportOpt.mmap = true;
+        } else if (a == "--band" && i + 1 < argc) {
+            exportOpt.bandRows = std::stoi(argv[++i]);
+        } else if (a == "--aa" && i + 1 < argc) {
+            exportOpt.aa = std::stoi(argv[++i]);
+        } else if (a == "--aa-threshold" && i + 1 < argc) {
+            exportOpt.aaThreshold = std::stoi(argv[++i]);
+        } else if (a == "--aa-de" && i + 1 < argc) {
+            exportOpt.aaDe = std::stod(argv[++i]);
+        } else if (a == "--de") {
+            exportOpt.de = true;
+        } else if (a == "--smooth") {
+            exportOpt.smooth = true;
+        } else if (a == "--compress") {
+            exportOpt.compress = true;
+        } else if (a == "--recolor" && i + 2 < argc) {
+            recolorIn  = argv[++i];
+            recolorOut = argv[++i];
+        } else if (a == "--formula" && i + 1 < argc) {
+            if (!escape::parse_formula(argv[++i], formula)) {
+                std::cerr << "Unknown formula " << argv[i]
+                          << " (mandelbrot, multibrot3, multibrot4, burningship, tricorn)\n";
+                return 1;
+            }
+        } else if (a == "--float") {
+            precision = escape::Precision::Float;
+        } else if (a == "--atlas" && i + 1 < argc) {
+            doAtlas = true;
+            atlasOpt.path = argv[++i];
+        } else if (a == "--atlas-grid" && i + 1 < argc) {
+            atlasOpt.grid = std::stoi(argv[++i]);
+        } else if (a == "--atlas-thumb" && i + 1 < argc) {
+            atlasOpt.thumb = std::stoi(argv[++i]);
+        } else if (a == "--julia-boundary" && i + 1 < argc) {
+            boundaryOut = argv[++i];
+        } else if (a == "--hit-limit" && i + 1 < argc) {
+            hitLimit = std::stoi(argv[++i]);
+        } else if (a == "--julia-c" && i + 2 < argc) {
+            juliaRe = std::stod(argv[++i]);
+            juliaIm = std::stod(argv[++i]);
+        } else if (a == "--buddhabrot" && i + 1 < argc) {
+            doBuddha = true;
+            buddhaOpt.path = argv[++i];
+        } else if (a == "--samples" && i + 1 < argc) {
+            buddhaOpt.samples = std::stoull(argv[++i]);
+        } else if (a == "--buddha-iter" && i + 2 < argc) {
+            buddhaOpt.minIter = std::stoi(argv[++i]);
+            buddhaOpt.maxIter = std::stoi(argv[++i]);
+        } else if (a == "--buddha-view" && i + 4 < argc) {
+            buddhaOpt.customView = true;
+            buddhaOpt.minRe = std::stod(argv[++i]);
+            buddhaOpt.maxRe = std::stod(argv[++i]);
+            buddhaOpt.minIm = std::stod(argv[++i]);
+            buddhaOpt.maxIm = std::stod(argv[++i]);
+        } else if (a == "--metropolis") {
+            buddhaOpt.metropolis = true;
+        } else if (a == "--checkpoint" && i + 1 < argc) {
+            buddhaOpt.checkpoint = argv[++i];
+        } else if (a == "--checkpoint-every" && i + 1 < argc) {
+            buddhaOpt.checkpointEvery = std::stoull(argv[++i]);
+        } else if (a == "--palette" && i + 1 < argc) {
+            palette = argv[++i];
+        } else if (a == "--trace" && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (a == "--metrics" && i + 1 < argc) {
+            metricsPath = argv[++i];
+        } else if (a == "--metrics-interval" && i + 1 < argc) {
+            metricsInterval = std::max(0, std::stoi(argv[++i]));
+        } else if (a == "--latency" && i + 1 < argc) {
+            latencyPath = argv[++i];
+        } else if (a == "--verbose") {
+            metrics::console = true;
         } else if (is_number(a.c_str())) {
             width = std::stoi(a);
             if (i + 1 < argc && is_number(argv[i+1])) {
@@ -34,16 +207,71 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    // --trace FILE: spans of whatever runs below, written when main returns
+    trace::name_thread("main");
+    trace::Session traceSession(tracePath);
+    // --metrics FILE: one JSON line per rendered frame
+    metrics::LogFile metricsLog(metricsPath, metricsInterval);
+
+    if (!recolorIn.empty()) {
+        return run_recolor(recolorIn, recolorOut, palette);
+    }
+
+    if (doAtlas) {
+        atlasOpt.threads   = useSingle ? 1 : 0;
+        atlasOpt.formula   = formula;
+        atlasOpt.precision = precision;
+        return run_atlas(atlasOpt);
+    }
+
+    if (doBuddha) {
+        buddhaOpt.width   = width;
+        buddhaOpt.height  = height;
+        buddhaOpt.threads = useSingle ? 1 : 0;
+        return run_buddhabrot(buddhaOpt);
+    }
+
+    if (!boundaryOut.empty()) {
+        return run_julia_boundary(boundaryOut, width, height, juliaRe, juliaIm, formula,
+                                  hitLimit, useSingle ? 1 : 0);
+    }
+
+    if (!exportOpt.path.empty()) {
+        exportOpt.width  = width;
+        exportOpt.height = height;
+        exportOpt.threads = useSingle ? 1 : 0;
+        exportOpt.formula   = formula;
+        exportOpt.precision = precision;
+        return run_export(exportOpt);
+    }
+
+    if (doVerify) {
+        verifyOpt.width   = width;
+        verifyOpt.height  = height;
+        verifyOpt.threads = useSingle ? 1 : benchOpt.threads;
+        verifyOpt.scenes  = benchOpt.scenes;
+        verifyOpt.formula = formula;
+        return run_verify(verifyOpt);
+    }
+
     if (doBenchmark) {
-        int rc = run_benchmark(width, height, "img/benchmark/benchmark.png");
-        if (rc == 0) {
-            std::cout << "Benchmark image saved to img/benchmark/benchmark.png\n";
-        } else {
+        benchOpt.width     = width;
+        benchOpt.height    = height;
+        if (useSingle) benchOpt.threads = 1;
+        benchOpt.formula   = formula;
+        benchOpt.precision = precision;
+        if (doKernelBench) return run_kernel_bench(benchOpt);
+        int rc = run_benchmark(benchOpt);
+        if (rc == 1) {
             std::cerr << "Benchmark failed.\n";
+        } else {
+            std::cout << "Benchmark image saved to " << benchOpt.out << "\n";
         }
         return rc;
     }
 
-    Gui app(width, height, useGPU, useSingle);
+    Gui app(width, height, useSingle, refine);
+    app.setFormula(formula, precision);
+    app.setLatencyOut(latencyPath);
     return app.run();
 }
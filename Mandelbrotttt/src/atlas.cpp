@@ -0,0 +1,70 @@
+#include "atlas.h"
+#include "julia.h"
+#include "image_save.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+// thumbnails iterated together, one c per lane (see escape::iterate_streams)
+static constexpr int atlasLanes = 4;
+
+int run_atlas(const AtlasOptions& opt) {
+    const int G = opt.grid, T = opt.thumb, gap = 2;
+    if (G < 1 || T < 2) {
+        std::cerr << "Atlas needs grid >= 1 and thumb >= 2\n";
+        return 1;
+    }
+    const int W = G * T + (G + 1) * gap, H = W;
+    const int maxIter = Julia::maxIter;
+    std::vector<uint32_t> img(size_t(W) * H, 0xFF202020u);
+
+    std::cout << "Atlas " << G << "x" << G << " Julia sets (" << escape::formula_name(opt.formula)
+              << "), " << T << " px each, c in [" << opt.minRe << ", " << opt.maxRe << "] x ["
+              << opt.minIm << ", " << opt.maxIm << "]\n";
+
+    const double zMin = -1.6, zMax = 1.6;
+    const double zF = (zMax - zMin) / double(T - 1);
+    const double cRF = (opt.maxRe - opt.minRe) / G, cIF = (opt.maxIm - opt.minIm) / G;
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+    escape::dispatch(opt.formula, opt.precision, true, [&](auto k) {
+        using K    = decltype(k);
+        using F    = typename K::formula;
+        using Real = typename K::real;
+        constexpr int L = atlasLanes;
+
+        // work unit = L consecutive thumbnails (row-major over the grid)
+        const int groups = (G * G + L - 1) / L;
+        escape::split_rows(0, groups, opt.threads, [&](int g0, int g1) {
+            for (int g = g0; g < g1; ++g) {
+                int first = g * L, lanes = std::min(L, G * G - first);
+                Real cr[L], ci[L];
+                for (int l = 0; l < L; ++l) {
+                    int t = first + std::min(l, lanes - 1);   // spare lanes repeat the last c
+                    cr[l] = Real(opt.minRe + (t % G + 0.5) * cRF);
+                    ci[l] = Real(opt.maxIm - (t / G + 0.5) * cIF);
+                }
+                // lane l walks the pixels of thumbnail first + l
+                escape::iterate_streams<F, L>(cr, ci, T * T, maxIter,
+                    [&](int, int p, Real& zr, Real& zi) {
+                        zr = Real(zMin + (p % T) * zF);
+                        zi = Real(zMax - (p / T) * zF);
+                    },
+                    [&](int l, int p, int n) {
+                        if (l >= lanes) return;
+                        int t = first + l;
+                        img[size_t(gap + (t / G) * (T + gap) + p / T) * W
+                            + gap + (t % G) * (T + gap) + p % T] = escape::Bands::value(n, maxIter);
+                    });
+            }
+        });
+    });
+    auto t1 = std::chrono::high_resolution_clock::now();
+    std::cout << "[atlas] compute "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count() << " ms\n";
+
+    save_png_from_buffer(img.data(), W, H, opt.path);
+    return 0;
+}
@@ -1,63 +1,774 @@
 #include "benchmark.h"
 #include "mandelbrot.h"
+#include "julia.h"
 #include "font5x7.h"
 #include "image_save.h"
+#include "perfcount.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <chrono>
-#include <string>
-#include <vector>
+#include <cmath>
+#include <cstdio>
 #include <filesystem>
+#include <fstream>
+#include <functional>
 #include <iostream>
-#include <functional>  
-#include <thread>     
-#include <cstdio>     
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Scene {
+    const char* name;
+    bool   julia;
+    double re, im, span;    // Mandelbrot view centre and width
+    int    maxIter;
+};
+
+const Scene scenes[] = {
+    { "full",     false, -0.5,               0.0,               3.0,   500  },
+    { "seahorse", false, -0.745,             0.105,             0.03,  500  },
+    { "interior", false, -0.25,              0.0,               0.9,   500  },
+    { "deep",     false, -0.743643887037151, 0.131825904205330, 1e-9,  2000 },
+    { "julia",    true,  0.0,                0.0,               0.0,   500  },
+};
+
+struct Stats {
+    double min = 0, median = 0, p95 = 0, mean = 0, stddev = 0;
+};
+
+struct Result {
+    std::string scene;
+    int    threads;
+    double warmupMs;               // mean of the warm-up runs (0 if none)
+    std::vector<double> ms;        // one per timed run
+    Stats  s;
+    std::vector<double> busyMs;    // per worker, mean over the timed runs
+    double imbalance  = 1.0;       // slowest worker / mean worker busy time
+    double speedup    = 1.0;       // median vs the 1-thread median
+    double efficiency = 1.0;       // speedup / threads
+    uint64_t iterations = 0;       // per frame, counted by render_rows
+    double gips       = 0.0;       // giga-iterations per second at the median
+    PerfTotals perf;               // hardware counters per frame, whole render
+    std::vector<PerfTotals> perfWorkers;   // same, per worker
+};
+
+// split_rows probe: busy time and (with counters on) hardware counts per worker.
+// Counters bind to the thread that opens them, and split_rows starts new threads
+// every time, so each slice opens its own. Slice i's state is only touched by
+// the worker running it.
+class WorkerProbe : public escape::SliceProbe {
+public:
+    explicit WorkerProbe(bool counters) : counters(counters) {}
+
+    void slices(int n) override {
+        if (int(busyMs.size()) >= n) return;
+        busyMs.resize(n, 0.0);
+        perf.resize(n);
+        t0.resize(n);
+        open.resize(n);
+    }
+    void begin(int i) override {
+        if (counters) {
+            open[i].reset(new PerfCounters());
+            open[i]->start();
+        }
+        t0[i] = std::chrono::steady_clock::now();
+    }
+    void end(int i) override {
+        auto t1 = std::chrono::steady_clock::now();
+        busyMs[i] += std::chrono::duration<double, std::milli>(t1 - t0[i]).count();
+        if (counters) {
+            open[i]->stop();
+            perf[i].add(*open[i]);
+            open[i].reset();
+        }
+    }
 
-static long long time_ms(std::function<void()> fn) {
-    auto t0 = std::chrono::high_resolution_clock::now();
+    std::vector<double>     busyMs;
+    std::vector<PerfTotals> perf;
+
+private:
+    bool counters;
+    std::vector<std::chrono::steady_clock::time_point> t0;
+    std::vector<std::unique_ptr<PerfCounters>> open;
+};
+
+// "" for a missing event, so CSV cells stay empty
+std::string perf_cell(const PerfTotals& p, PerfCounters::Event e) {
+    if (!p.has[e]) return "";
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.0f", p.v[e]);
+    return buf;
+}
+
+// {"cycles": ..., ..., "ipc": ...}, missing events as null
+std::string perf_json(const PerfTotals& p) {
+    std::string j = "{";
+    for (int e = 0; e < PerfCounters::EventCount; ++e) {
+        std::string v = perf_cell(p, PerfCounters::Event(e));
+        j += std::string(e ? ", " : "") + "\"" + PerfCounters::name(PerfCounters::Event(e)) + "\": " +
+             (v.empty() ? "null" : v);
+    }
+    char buf[48];
+    std::snprintf(buf, sizeof(buf), ", \"ipc\": %.3f}", p.ipc());
+    return j + buf;
+}
+
+double time_ms(const std::function<void()>& fn) {
+    auto t0 = std::chrono::steady_clock::now();
     fn();
-    auto t1 = std::chrono::high_resolution_clock::now();
-    return std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+// p95 by nearest rank; sample standard deviation
+Stats stats_of(std::vector<double> v) {
+    Stats s;
+    if (v.empty()) return s;
+    std::sort(v.begin(), v.end());
+    size_t n = v.size();
+    s.min    = v.front();
+    s.median = n % 2 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+    s.p95    = v[size_t(std::ceil(0.95 * n)) - 1];
+    double sum = 0;
+    for (double x : v) sum += x;
+    s.mean = sum / n;
+    double sq = 0;
+    for (double x : v) sq += (x - s.mean) * (x - s.mean);
+    s.stddev = n > 1 ? std::sqrt(sq / (n - 1)) : 0.0;
+    return s;
+}
+
+bool wanted(const std::string& list, const char* name) {
+    if (list.empty()) return true;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        if (item == name) return true;
+    return false;
+}
+
+std::string upper(std::string s) {
+    for (char& c : s) c = char(std::toupper((unsigned char)c));
+    return s;
+}
+
+std::string fmt(const char* f, double v) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), f, v);
+    return buf;
+}
+
+bool write_csv(const std::string& path, const BenchOptions& opt, const std::vector<Result>& rs) {
+    std::FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) return false;
+    std::fprintf(f, "scene,threads,width,height,reps,warmup_ms,min_ms,median_ms,p95_ms,mean_ms,stddev_ms,"
+                    "speedup,efficiency,imbalance,iterations,giter_per_s,"
+                    "cycles,instructions,ipc,branch_misses,cache_misses\n");
+    for (const Result& r : rs) {
+        std::fprintf(f, "%s,%d,%d,%d,%zu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.4f,%.4f,%.4f,%llu,%.4f,",
+                     r.scene.c_str(), r.threads, opt.width, opt.height, r.ms.size(), r.warmupMs,
+                     r.s.min, r.s.median, r.s.p95, r.s.mean, r.s.stddev,
+                     r.speedup, r.efficiency, r.imbalance, (unsigned long long)r.iterations, r.gips);
+        std::string ipc = r.perf.ipc() > 0 ? fmt("%.3f", r.perf.ipc()) : "";
+        std::fprintf(f, "%s,%s,%s,%s,%s\n",
+                     perf_cell(r.perf, PerfCounters::Cycles).c_str(),
+                     perf_cell(r.perf, PerfCounters::Instructions).c_str(), ipc.c_str(),
+                     perf_cell(r.perf, PerfCounters::BranchMisses).c_str(),
+                     perf_cell(r.perf, PerfCounters::CacheMisses).c_str());
+    }
+    return std::fclose(f) == 0;
+}
+
+bool write_json(const std::string& path, const BenchOptions& opt, const std::vector<Result>& rs) {
+    std::FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) return false;
+    std::fprintf(f, "{\n  \"width\": %d,\n  \"height\": %d,\n  \"reps\": %d,\n  \"warmup\": %d,\n"
+                    "  \"formula\": \"%s\",\n  \"scaling\": %s,\n  \"perf\": %s,\n  \"results\": [\n",
+                 opt.width, opt.height, opt.reps, opt.warmup, escape::formula_name(opt.formula),
+                 opt.scaling ? "true" : "false", opt.perf ? "true" : "false");
+    for (size_t i = 0; i < rs.size(); ++i) {
+        const Result& r = rs[i];
+        std::fprintf(f, "    {\"scene\": \"%s\", \"threads\": %d, \"warmup_ms\": %.3f, \"min_ms\": %.3f, "
+                        "\"median_ms\": %.3f, \"p95_ms\": %.3f, \"mean_ms\": %.3f, \"stddev_ms\": %.3f, "
+                        "\"speedup\": %.4f, \"efficiency\": %.4f, \"imbalance\": %.4f, "
+                        "\"iterations\": %llu, \"giter_per_s\": %.4f, \"samples_ms\": [",
+                     r.scene.c_str(), r.threads, r.warmupMs, r.s.min, r.s.median, r.s.p95,
+                     r.s.mean, r.s.stddev, r.speedup, r.efficiency, r.imbalance,
+                     (unsigned long long)r.iterations, r.gips);
+        for (size_t k = 0; k < r.ms.size(); ++k)
+            std::fprintf(f, "%s%.3f", k ? ", " : "", r.ms[k]);
+        std::fprintf(f, "], \"busy_ms\": [");
+        for (size_t k = 0; k < r.busyMs.size(); ++k)
+            std::fprintf(f, "%s%.3f", k ? ", " : "", r.busyMs[k]);
+        std::fprintf(f, "]");
+        if (opt.perf) {
+            std::fprintf(f, ", \"perf\": %s, \"perf_threads\": [", perf_json(r.perf).c_str());
+            for (size_t k = 0; k < r.perfWorkers.size(); ++k)
+                std::fprintf(f, "%s%s", k ? ", " : "", perf_json(r.perfWorkers[k]).c_str());
+            std::fprintf(f, "]");
+        }
+        std::fprintf(f, "}%s\n", i + 1 < rs.size() ? "," : "");
+    }
+    std::fprintf(f, "  ]\n}\n");
+    return std::fclose(f) == 0;
+}
+
+void draw_line(std::vector<uint32_t>& img, int W, int H, int x0, int y0, int x1, int y1,
+               uint32_t color) {
+    int n = std::max(std::abs(x1 - x0), std::abs(y1 - y0));
+    for (int i = 0; i <= n; ++i) {
+        int x = n ? x0 + (x1 - x0) * i / n : x0;
+        int y = n ? y0 + (y1 - y0) * i / n : y0;
+        if (x >= 0 && x < W && y >= 0 && y < H) img[size_t(y) * W + x] = color;
+    }
+}
+
+void fill_rect(std::vector<uint32_t>& img, int W, int H, int x, int y, int w, int h, uint32_t color) {
+    for (int yy = std::max(0, y); yy < std::min(H, y + h); ++yy)
+        for (int xx = std::max(0, x); xx < std::min(W, x + w); ++xx)
+            img[size_t(yy) * W + xx] = color;
 }
 
-int run_benchmark(int width, int height, const std::string& out_png) {
+const uint32_t sceneColors[] = { 0xFF66FFFFu, 0xFFFF6666u, 0xFF66FF66u, 0xFFFFAA33u, 0xFFCC88FFu };
+
+// speedup against threads (log2 axis), one line per scene, plus the ideal t
+void draw_scaling_chart(std::vector<uint32_t>& img, int W, int H, int x0, int y0, int cw, int ch,
+                        const std::vector<Result>& rs, const std::vector<int>& counts) {
+    const uint32_t axis = 0xFFAAAAAAu, grid = 0xFF333333u, ideal = 0xFF777777u;
+    const int tMax = counts.back();
+    double yMax = tMax;
+    for (const Result& r : rs) yMax = std::max(yMax, r.speedup);
+    const double lMax = std::max(1.0, std::log2(double(tMax)));
+    auto px = [&](double t) { return x0 + int(cw * std::log2(t) / lMax + 0.5); };
+    auto py = [&](double v) { return y0 + ch - int(ch * v / yMax + 0.5); };
+
+    for (int k = 0; k <= 4; ++k) {
+        double v = yMax * k / 4;
+        draw_line(img, W, H, x0, py(v), x0 + cw, py(v), grid);
+        draw_text_rgba(img.data(), W, H, x0 - 60, py(v) - 7, fmt(yMax < 8 ? "%.1f" : "%.0f", v), axis, 2);
+    }
+    for (int t : counts) {
+        draw_line(img, W, H, px(t), y0, px(t), y0 + ch, grid);
+        draw_text_rgba(img.data(), W, H, px(t) - 6, y0 + ch + 10, std::to_string(t), axis, 2);
+    }
+    draw_line(img, W, H, x0, y0 + ch, x0 + cw, y0 + ch, axis);
+    draw_line(img, W, H, x0, y0, x0, y0 + ch, axis);
+    draw_text_rgba(img.data(), W, H, x0 + cw / 2 - 42, y0 + ch + 34, "THREADS", axis, 2);
+    draw_text_rgba(img.data(), W, H, x0 - 60, y0 - 24, "SPEEDUP", axis, 2);
+
+    // ideal speedup is a curve on a log axis
+    for (int k = 0; k < 64; ++k) {
+        double a = std::exp2(lMax * k / 64), b = std::exp2(lMax * (k + 1) / 64);
+        if (b > tMax) b = tMax;
+        draw_line(img, W, H, px(a), py(a), px(b), py(b), ideal);
+    }
+
+    int legend = 0;
+    std::string last;
+    for (size_t i = 0; i < rs.size(); ++i) {
+        const Result& r = rs[i];
+        if (r.scene != last) {
+            last = r.scene;
+            uint32_t c = sceneColors[legend % 5];
+            int ly = y0 + 24 * legend;
+            fill_rect(img, W, H, x0 + cw + 30, ly + 3, 10, 10, c);
+            draw_text_rgba(img.data(), W, H, x0 + cw + 48, ly, upper(r.scene), c, 2);
+            ++legend;
+        }
+        uint32_t c = sceneColors[(legend - 1) % 5];
+        fill_rect(img, W, H, px(r.threads) - 3, py(r.speedup) - 3, 7, 7, c);
+        if (i > 0 && rs[i - 1].scene == r.scene)
+            draw_line(img, W, H, px(rs[i - 1].threads), py(rs[i - 1].speedup),
+                      px(r.threads), py(r.speedup), c);
+    }
+}
+
+// result card: one row per scene and thread count, and the scaling chart above
+// the table in --benchmark-scaling mode
+void write_card(const std::string& path, const BenchOptions& opt, const std::vector<Result>& rs,
+                const std::vector<int>& counts) {
+    const int W = 1120, rowH = 24, chartH = opt.scaling ? 420 : 0, top = 110 + chartH;
+    const int H = top + rowH * int(rs.size() + 1) + 20;
+    std::vector<uint32_t> img(size_t(W) * H, 0xFF111111u); // dark gray background
+
+    // Frame/border
+    uint32_t white = 0xFFFFFFFFu, cyan = 0xFF66FFFFu, yellow = 0xFFFFFF66u, gray = 0xFFAAAAAAu;
+    for (int x = 0; x < W; ++x) { img[x] = white; img[size_t(H-1)*W + x] = white; }
+    for (int y = 0; y < H; ++y) { img[size_t(y)*W] = white; img[size_t(y)*W + (W-1)] = white; }
+
+    draw_text_rgba(img.data(), W, H, 20, 20, opt.scaling ? "THREAD SCALING" : "BENCHMARK", cyan, 3);
+    draw_text_rgba(img.data(), W, H, 20, 60,
+                   std::to_string(opt.width) + "X" + std::to_string(opt.height) + "  " +
+                   upper(escape::formula_name(opt.formula)) + "  " + std::to_string(opt.reps) +
+                   " RUNS, " + std::to_string(opt.warmup) + " WARM-UP", gray, 2);
+    if (opt.scaling) draw_scaling_chart(img, W, H, 100, 140, 640, 300, rs, counts);
+
+    const int cols[] = { 20, 160, 230, 360, 480, 580, 710, 810, 920 };
+    const char* heads[] = { "SCENE", "THR", "MEDIAN", "P95", "SD", "SPEEDUP", "EFF", "IMBAL", "GITER/S" };
+    for (int c = 0; c < 9; ++c) draw_text_rgba(img.data(), W, H, cols[c], top, heads[c], cyan, 2);
+
+    for (size_t i = 0; i < rs.size(); ++i) {
+        const Result& r = rs[i];
+        int y = top + rowH * int(i + 1);
+        draw_text_rgba(img.data(), W, H, cols[0], y, upper(r.scene), white, 2);
+        draw_text_rgba(img.data(), W, H, cols[1], y, std::to_string(r.threads), white, 2);
+        draw_text_rgba(img.data(), W, H, cols[2], y, fmt("%.2f", r.s.median), white, 2);
+        draw_text_rgba(img.data(), W, H, cols[3], y, fmt("%.2f", r.s.p95), white, 2);
+        draw_text_rgba(img.data(), W, H, cols[4], y, fmt("%.2f", r.s.stddev), white, 2);
+        draw_text_rgba(img.data(), W, H, cols[8], y, fmt("%.3f", r.gips), white, 2);
+        if (r.threads > 1) {
+            draw_text_rgba(img.data(), W, H, cols[5], y, fmt("%.2fX", r.speedup), yellow, 2);
+            draw_text_rgba(img.data(), W, H, cols[6], y, fmt("%.0f%%", 100.0 * r.efficiency), yellow, 2);
+            draw_text_rgba(img.data(), W, H, cols[7], y, fmt("%.2f", r.imbalance), white, 2);
+        }
+    }
+
+    // the PNG writer stores rows bottom-up, so hand it the card upside down
+    for (int y = 0; y < H / 2; ++y)
+        std::swap_ranges(img.begin() + size_t(y) * W, img.begin() + size_t(y + 1) * W,
+                         img.begin() + size_t(H - 1 - y) * W);
+    save_png_from_buffer(img.data(), W, H, path);
+}
+
+// ---- baseline ----
+// Text file, one line per scene and thread count:
+//   scene threads width height formula precision runs ms...
+// A run is compared per (scene, threads) line; lines from another size,
+// formula or precision are skipped with a warning.
+
+struct BaselineRow {
+    std::string scene, formula, precision;
+    int threads = 0, width = 0, height = 0;
+    std::vector<double> ms;
+};
+
+const char* precision_name(escape::Precision p) {
+    return p == escape::Precision::Float ? "float" : "double";
+}
+
+bool write_baseline(const std::string& path, const BenchOptions& opt, const std::vector<Result>& rs) {
+    std::FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) return false;
+    std::fprintf(f, "# mandelbrotttt benchmark baseline: scene threads width height formula precision runs ms...\n");
+    for (const Result& r : rs) {
+        std::fprintf(f, "%s %d %d %d %s %s %zu", r.scene.c_str(), r.threads, opt.width, opt.height,
+                     escape::formula_name(opt.formula), precision_name(opt.precision), r.ms.size());
+        for (double v : r.ms) std::fprintf(f, " %.4f", v);
+        std::fprintf(f, "\n");
+    }
+    return std::fclose(f) == 0;
+}
+
+bool read_baseline(const std::string& path, std::vector<BaselineRow>& rows) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream ss(line);
+        BaselineRow b;
+        size_t n = 0;
+        if (!(ss >> b.scene >> b.threads >> b.width >> b.height >> b.formula >> b.precision >> n))
+            return false;
+        b.ms.resize(n);
+        for (double& v : b.ms)
+            if (!(ss >> v)) return false;
+        rows.push_back(std::move(b));
+    }
+    return true;
+}
+
+// One-sided Mann-Whitney U test: p-value for "a tends to be larger than b" (a
+// run is slower). Rank-based, so a stray slow run doesn't decide it and timings
+// needn't be normal. Exact null distribution for small samples (ties count
+// half, against the tie-free distribution), normal approximation otherwise.
+double mann_whitney_p(const std::vector<double>& a, const std::vector<double>& b) {
+    const int n = int(a.size()), m = int(b.size());
+    if (n == 0 || m == 0) return 1.0;
+    double u = 0;
+    for (double x : a)
+        for (double y : b) u += x > y ? 1.0 : x == y ? 0.5 : 0.0;
+
+    if (n * m > 400) {
+        double mu = n * m / 2.0, sd = std::sqrt(n * m * (n + m + 1) / 12.0);
+        return 0.5 * std::erfc((u - 0.5 - mu) / (sd * std::sqrt(2.0)));
+    }
+    // count[i][j][k]: orderings of i a's and j b's with U = k
+    std::vector<std::vector<std::vector<double>>> count(n + 1, std::vector<std::vector<double>>(m + 1));
+    for (int i = 0; i <= n; ++i)
+        for (int j = 0; j <= m; ++j) {
+            std::vector<double>& c = count[i][j];
+            c.assign(size_t(i) * j + 1, 0.0);
+            if (i == 0 || j == 0) { c[0] = 1.0; continue; }
+            // the largest value is an a (beats all j b's) or a b
+            for (int k = 0; k <= i * j; ++k)
+                c[k] = (k >= j ? count[i - 1][j][k - j] : 0.0) +
+                       (k <= i * (j - 1) ? count[i][j - 1][k] : 0.0);
+        }
+    const std::vector<double>& c = count[n][m];
+    double total = 0, tail = 0;
+    for (int k = 0; k <= n * m; ++k) {
+        total += c[k];
+        if (k >= std::ceil(u)) tail += c[k];
+    }
+    return tail / total;
+}
+
+// smallest p mann_whitney_p can return for samples of n and m: 1 / C(n+m, n)
+double mann_whitney_min_p(int n, int m) {
+    double p = 1.0;
+    for (int i = 1; i <= n; ++i) p *= double(i) / double(m + i);
+    return p;
+}
+
+// per-scene deltas against the baseline; returns the number of regressions
+int compare_baseline(const std::vector<BaselineRow>& base, const BenchOptions& opt,
+                     const std::vector<Result>& rs) {
+    const double alpha = 0.05;
+    int regressions = 0;
+    std::printf("\nAgainst baseline %s (regression: >%.1f%% slower median, p < %.2f):\n",
+                opt.baseline.c_str(), opt.threshold, alpha);
+    for (const Result& r : rs) {
+        const BaselineRow* b = nullptr;
+        for (const BaselineRow& row : base)
+            if (row.scene == r.scene && row.threads == r.threads) b = &row;
+        if (!b) {
+            std::printf("  %-9s %3d thr  not in baseline\n", r.scene.c_str(), r.threads);
+            continue;
+        }
+        if (b->width != opt.width || b->height != opt.height ||
+            b->formula != escape::formula_name(opt.formula) || b->precision != precision_name(opt.precision)) {
+            std::printf("  %-9s %3d thr  baseline is %dx%d %s %s, not comparable\n", r.scene.c_str(),
+                        r.threads, b->width, b->height, b->formula.c_str(), b->precision.c_str());
+            continue;
+        }
+        double was   = stats_of(b->ms).median;
+        double delta = was > 0 ? 100.0 * (r.s.median - was) / was : 0.0;
+        double pSlow = mann_whitney_p(r.ms, b->ms);
+        double pFast = mann_whitney_p(b->ms, r.ms);
+        const char* verdict = "same";
+        if (mann_whitney_min_p(int(r.ms.size()), int(b->ms.size())) >= alpha) {
+            // too few runs for the test to ever reach alpha (3 vs 3: p >= 0.05), so the
+            // median threshold decides alone
+            if (delta > opt.threshold)       { verdict = "REGRESSION (median only, too few runs for p)"; ++regressions; }
+            else if (delta < -opt.threshold) verdict = "faster (median only, too few runs for p)";
+            else                             verdict = "same (too few runs for p)";
+        }
+        else if (pSlow < alpha && delta > opt.threshold) { verdict = "REGRESSION"; ++regressions; }
+        else if (pSlow < alpha)                      verdict = "slower (under threshold)";
+        else if (pFast < alpha)                      verdict = "faster";
+        std::printf("  %-9s %3d thr  %9.3f -> %9.3f ms  %+7.2f%%  p %.4f  %s\n", r.scene.c_str(),
+                    r.threads, was, r.s.median, delta, std::min(pSlow, pFast), verdict);
+    }
+    return regressions;
+}
+
+// ---- kernel microbenchmark ----
+// fixed batches of points, every kernel single-threaded over the same batch
+
+struct Batch {
+    const char* name;
+    bool   julia;                       // points are z0 for c = (-0.8, 0.156), else c
+    double minRe, maxRe, minIm, maxIm;
+};
+
+const Batch batches[] = {
+    { "full",     false, -2.0,  1.0,  -1.0, 1.0  },
+    { "seahorse", false, -0.76, -0.73, 0.09, 0.12 },
+    { "julia",    true,  -1.5,  1.5,  -1.2, 1.2  },
+};
+constexpr int    batchSide = 128, batchIter = 1000;
+constexpr double batchCRe = -0.8, batchCIm = 0.156;
+
+struct KernelResult {
+    std::string kernel, precision, batch;
+    std::vector<double> ms;
+    Stats    s;
+    uint64_t iterations = 0;
+    double   gips = 0.0;
+};
+
+// iterate() once per point, the loop render_rows runs
+template <class F, class Real>
+uint64_t batch_scalar(const Batch& b, const std::vector<double>& re, const std::vector<double>& im) {
+    uint64_t work = 0;
+    for (size_t i = 0; i < re.size(); ++i) {
+        Real zr = Real(0), zi = Real(0), cr = Real(re[i]), ci = Real(im[i]);
+        if (b.julia) { zr = cr; zi = ci; cr = Real(batchCRe); ci = Real(batchCIm); }
+        work += uint64_t(escape::iterate<F>(zr, zi, cr, ci, batchIter));
+    }
+    return work;
+}
+
+// iterate_streams with L lanes (the atlas kernel); one c per lane, so Julia batches only
+template <class F, class Real, int L>
+uint64_t batch_lanes(const Batch&, const std::vector<double>& re, const std::vector<double>& im) {
+    Real cr[L], ci[L];
+    for (int l = 0; l < L; ++l) { cr[l] = Real(batchCRe); ci[l] = Real(batchCIm); }
+    const int per = int(re.size()) / L;
+    uint64_t work = 0;
+    escape::iterate_streams<F, L>(cr, ci, per, batchIter,
+        [&](int l, int i, Real& zr, Real& zi) {
+            zr = Real(re[size_t(l) * per + i]);
+            zi = Real(im[size_t(l) * per + i]);
+        },
+        [&](int, int, int n) { work += uint64_t(n); });
+    return work;
+}
+
+struct KernelEntry {
+    const char* name;
+    const char* precision;
+    bool juliaOnly;
+    std::function<uint64_t(const Batch&, const std::vector<double>&, const std::vector<double>&)> run;
+};
+
+bool write_kernel_csv(const std::string& path, const std::vector<KernelResult>& rs) {
+    std::FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) return false;
+    std::fprintf(f, "kernel,precision,batch,points,max_iter,reps,min_ms,median_ms,p95_ms,stddev_ms,"
+                    "iterations,giter_per_s,ns_per_iter\n");
+    for (const KernelResult& r : rs)
+        std::fprintf(f, "%s,%s,%s,%d,%d,%zu,%.4f,%.4f,%.4f,%.4f,%llu,%.4f,%.4f\n",
+                     r.kernel.c_str(), r.precision.c_str(), r.batch.c_str(), batchSide * batchSide,
+                     batchIter, r.ms.size(), r.s.min, r.s.median, r.s.p95, r.s.stddev,
+                     (unsigned long long)r.iterations, r.gips, r.gips > 0 ? 1.0 / r.gips : 0.0);
+    return std::fclose(f) == 0;
+}
+
+} // namespace
+
+int run_benchmark(const BenchOptions& request) {
+    BenchOptions opt = request;
     try {
-        std::filesystem::create_directories(std::filesystem::path(out_png).parent_path());
+        std::filesystem::create_directories(std::filesystem::path(opt.out).parent_path());
     } catch (...) {}
 
-    Fractal f(width, height);
+    // counters are optional: without them (VMs, containers, perf_event_paranoid)
+    // the run goes on and the perf columns stay empty
+    if (opt.perf) {
+        PerfCounters probe(true);
+        if (!probe.available()) {
+            std::cout << "Hardware counters unavailable (" << probe.error() << "), continuing without\n";
+            opt.perf = false;
+        } else if (!probe.error().empty()) {
+            std::cout << "Some hardware counters unavailable (" << probe.error() << ")\n";
+        }
+    }
 
-    f.compute_only(1);
+    int threads = opt.threads > 0 ? opt.threads : int(std::thread::hardware_concurrency());
+    if (threads <= 0) threads = 4;
+    // 1 and N, or in scaling mode 1, 2, 4, ... and N
+    std::vector<int> counts = { 1 };
+    if (opt.scaling)
+        for (int t = 2; t < threads; t *= 2) counts.push_back(t);
+    if (threads > 1) counts.push_back(threads);
 
-    long long t_single = time_ms([&](){ f.compute_only(1); });
+    std::cout << (opt.scaling ? "Thread scaling " : "Benchmark ") << opt.width << "x" << opt.height << ", " << opt.reps << " runs + "
+              << opt.warmup << " warm-up per scene and thread count\n";
 
-    int threads = int(std::thread::hardware_concurrency());
-    if (threads <= 0) threads = 4;
+    std::vector<Result> results;
+    for (const Scene& sc : scenes) {
+        if (!wanted(opt.scenes, sc.name)) continue;
 
-    long long t_multi = time_ms([&](){ f.compute_only(0); }); // auto threads
+        // set up outside the timed region; compute() is the silent compute_only
+        std::unique_ptr<Fractal> f;
+        std::unique_ptr<Julia>   j;
+        std::function<void(int)> render;
+        if (sc.julia) {
+            j.reset(new Julia(opt.width, opt.height));
+            j->setFormula(opt.formula);
+            j->setPrecision(opt.precision);
+            render = [&](int t) { j->compute(t); };
+        } else {
+            f.reset(new Fractal(opt.width, opt.height));
+            f->setFormula(opt.formula);
+            f->setPrecision(opt.precision);
+            f->setMaxIter(sc.maxIter);
+            f->setView(sc.re, sc.im, sc.span);
+            render = [&](int t) { f->compute(t); };
+        }
 
-    double speedup = (t_multi > 0) ? (double)t_single / (double)t_multi : 0.0;
+        double single = 0;
+        for (int t : counts) {
+            Result r;
+            r.scene = sc.name;
+            r.threads = t;
+            r.warmupMs = 0;
+            for (int i = 0; i < opt.warmup; ++i) r.warmupMs += time_ms([&] { render(t); });
+            if (opt.warmup > 0) r.warmupMs /= opt.warmup;
 
-    std::cout << "Single-thread: " << t_single << " ms\n";
-    std::cout << "Multi-thread (" << threads << "): " << t_multi << " ms\n";
-    std::cout << "Speedup: " << speedup << "x\n";
+            // worker figures come from split_rows; the mirrored/copied rows of a
+            // render are in there too, they are part of the work.
+            std::atomic<uint64_t> iters{0};
+            WorkerProbe probe(false);
+            escape::slice_probe = &probe;
+            escape::iteration_count = &iters;
+            for (int i = 0; i < opt.reps; ++i) r.ms.push_back(time_ms([&] { render(t); }));
+            escape::slice_probe = nullptr;
+            escape::iteration_count = nullptr;
+            r.busyMs = probe.busyMs;
 
-    // Create a simple image with textual table
-    const int W = 640, H = 220;
-    std::vector<uint32_t> img(W * H, 0xFF111111u); // dark gray background
+            // Counters come from their own (untimed) runs: opening them per worker
+            // costs syscalls inside the render. The whole-render counters inherit
+            // into the workers, so they include them; they are reopened per run,
+            // a reset doesn't clear counts from exited threads.
+            if (opt.perf) {
+                WorkerProbe counted(true);
+                escape::slice_probe = &counted;
+                for (int i = 0; i < opt.reps; ++i) {
+                    PerfCounters whole(true);
+                    whole.start();
+                    render(t);
+                    whole.stop();
+                    r.perf.add(whole);
+                }
+                escape::slice_probe = nullptr;
+                r.perfWorkers = counted.perf;
+                r.perf.scale(1.0 / opt.reps);
+                for (PerfTotals& p : r.perfWorkers) p.scale(1.0 / opt.reps);
+            }
+            r.s = stats_of(r.ms);
+            r.iterations = opt.reps > 0 ? iters.load() / uint64_t(opt.reps) : 0;
+            if (r.s.median > 0) r.gips = r.iterations / (r.s.median * 1e6);
 
-    // Frame/border
-    uint32_t white = 0xFFFFFFFFu, cyan = 0xFF66FFFFu, yellow = 0xFFFFFF66u;
-    for (int x = 0; x < W; ++x) { img[x] = white; img[(H-1)*W + x] = white; }
-    for (int y = 0; y < H; ++y) { img[y*W] = white; img[y*W + (W-1)] = white; }
+            double busyMax = 0, busySum = 0;
+            for (double& b : r.busyMs) {
+                b /= opt.reps;
+                busyMax = std::max(busyMax, b);
+                busySum += b;
+            }
+            if (busySum > 0) r.imbalance = busyMax * r.busyMs.size() / busySum;
+            if (t == 1) single = r.s.median;
+            if (r.s.median > 0) r.speedup = single / r.s.median;
+            r.efficiency = r.speedup / t;
+
+            std::printf("  %-9s %3d thr  warm-up %9.3f  median %9.3f  p95 %9.3f  sd %8.3f ms"
+                        "  speedup %5.2fx  eff %3.0f%%  imbalance %.2f  %.3f Giter/s\n",
+                        sc.name, t, r.warmupMs, r.s.median, r.s.p95, r.s.stddev,
+                        r.speedup, 100.0 * r.efficiency, r.imbalance, r.gips);
+            if (opt.perf)
+                std::printf("  %-9s %3s      cycles %s  instructions %s  IPC %.2f  branch-misses %s"
+                            "  cache-misses %s\n", "", "",
+                            perf_cell(r.perf, PerfCounters::Cycles).c_str(),
+                            perf_cell(r.perf, PerfCounters::Instructions).c_str(), r.perf.ipc(),
+                            perf_cell(r.perf, PerfCounters::BranchMisses).c_str(),
+                            perf_cell(r.perf, PerfCounters::CacheMisses).c_str());
+            std::fflush(stdout);
+            results.push_back(std::move(r));
+        }
+    }
+    if (results.empty()) {
+        std::cerr << "No benchmark scene matches \"" << opt.scenes
+                  << "\" (full, seahorse, interior, deep, julia)\n";
+        return 1;
+    }
+
+    std::filesystem::path base(opt.out);
+    std::string csv  = base.replace_extension(".csv").string();
+    std::string json = base.replace_extension(".json").string();
+    bool ok = write_csv(csv, opt, results) && write_json(json, opt, results);
+    if (!ok) {
+        std::cerr << "Failed to write " << csv << " / " << json << "\n";
+        return 1;
+    }
+    std::cout << "Wrote " << csv << " and " << json << "\n";
+    write_card(opt.out, opt, results, counts);
+
+    // compare against the baseline if there is one, else start it
+    int regressions = 0;
+    if (!opt.baseline.empty()) {
+        bool exists = std::filesystem::exists(opt.baseline);
+        if (exists) {
+            std::vector<BaselineRow> base;
+            if (!read_baseline(opt.baseline, base)) {
+                std::cerr << "Baseline " << opt.baseline << " is unreadable\n";
+                return 1;
+            }
+            regressions = compare_baseline(base, opt, results);
+        }
+        if (!exists || opt.updateBaseline) {
+            if (!write_baseline(opt.baseline, opt, results)) {
+                std::cerr << "Failed to write baseline " << opt.baseline << "\n";
+                return 1;
+            }
+            std::cout << (exists ? "Updated" : "Saved") << " baseline " << opt.baseline << "\n";
+        }
+        if (regressions)
+            std::cerr << regressions << " scene(s) regressed against " << opt.baseline << "\n";
+    }
+    return regressions ? 2 : 0;
+}
+
+int run_kernel_bench(const BenchOptions& opt) {
+    try {
+        std::filesystem::create_directories(std::filesystem::path(opt.out).parent_path());
+    } catch (...) {}
+
+    std::vector<KernelEntry> kernels;
+    escape::dispatch(opt.formula, escape::Precision::Double, false, [&](auto k) {
+        using F = typename decltype(k)::formula;
+        kernels = {
+            { "scalar", "double", false, batch_scalar<F, double> },
+            { "scalar", "float",  false, batch_scalar<F, float> },
+            { "lanes4", "double", true,  batch_lanes<F, double, 4> },
+            { "lanes4", "float",  true,  batch_lanes<F, float, 4> },
+            { "lanes8", "double", true,  batch_lanes<F, double, 8> },
+            { "lanes8", "float",  true,  batch_lanes<F, float, 8> },
+        };
+    });
+
+    std::cout << "Kernel microbenchmark: " << escape::formula_name(opt.formula) << ", "
+              << batchSide * batchSide << " points per batch, maxIter " << batchIter << ", "
+              << opt.reps << " runs + " << opt.warmup << " warm-up, 1 thread\n";
+
+    std::vector<KernelResult> results;
+    for (const Batch& b : batches) {
+        if (!wanted(opt.scenes, b.name)) continue;
+        std::vector<double> re, im;
+        for (int y = 0; y < batchSide; ++y)
+            for (int x = 0; x < batchSide; ++x) {
+                re.push_back(b.minRe + (b.maxRe - b.minRe) * x / (batchSide - 1));
+                im.push_back(b.maxIm - (b.maxIm - b.minIm) * y / (batchSide - 1));
+            }
 
-    draw_text_rgba(img.data(), W, H, 20, 20,  "BENCHMARK", cyan, 3);
-    draw_text_rgba(img.data(), W, H, 20, 80,  "SINGLE-TIME: " + std::to_string(t_single) + " MS", white, 2);
-    draw_text_rgba(img.data(), W, H, 20, 110, "MULTI(" + std::to_string(threads) + ") TIME: " + std::to_string(t_multi) + " MS", white, 2);
+        for (const KernelEntry& k : kernels) {
+            if (k.juliaOnly && !b.julia) continue;
+            KernelResult r;
+            r.kernel = k.name;
+            r.precision = k.precision;
+            r.batch = b.name;
+            for (int i = 0; i < opt.warmup; ++i) r.iterations = k.run(b, re, im);
+            for (int i = 0; i < opt.reps; ++i)
+                r.ms.push_back(time_ms([&] { r.iterations = k.run(b, re, im); }));
+            r.s = stats_of(r.ms);
+            if (r.s.median > 0) r.gips = r.iterations / (r.s.median * 1e6);
 
-    char buf[64];
-    std::snprintf(buf, sizeof(buf), "SPEEDUP: %.2f X", speedup);
-    draw_text_rgba(img.data(), W, H, 20, 150, buf, yellow, 3);
+            std::printf("  %-9s %-7s %-7s median %9.3f  p95 %9.3f ms  %12llu iter  %.3f Giter/s\n",
+                        b.name, k.name, k.precision, r.s.median, r.s.p95,
+                        (unsigned long long)r.iterations, r.gips);
+            std::fflush(stdout);
+            results.push_back(std::move(r));
+        }
+    }
+    if (results.empty()) {
+        std::cerr << "No kernel batch matches \"" << opt.scenes << "\" (full, seahorse, julia)\n";
+        return 1;
+    }
 
-    save_png_from_buffer(img.data(), W, H, out_png);
+    std::filesystem::path base(opt.out);
+    std::string csv = base.replace_filename(base.stem().string() + "_kernels.csv").string();
+    if (!write_kernel_csv(csv, results)) {
+        std::cerr << "Failed to write " << csv << "\n";
+        return 1;
+    }
+    std::cout << "Wrote " << csv << "\n";
     return 0;
 }
@@ -0,0 +1,276 @@
+#include "buddhabrot.h"
+#include "escape.h"
+#include "image_save.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <random>
+
+Buddhabrot::Buddhabrot(int w, int h, int maxIt, int minIt)
+  : width(w), height(h),
+    maxIter(maxIt), minIter(minIt),
+    useMetropolis(false), done(0),
+    density(size_t(w) * h, 0.0)
+{
+    double span = 3.0 * h / double(w);
+    setView(-2.0, 1.0, -span / 2, span / 2);
+}
+
+void Buddhabrot::setView(double mnRe, double mxRe, double mnIm, double mxIm) {
+    minRe = mnRe; maxRe = mxRe;
+    minIm = mnIm; maxIm = mxIm;
+}
+
+void Buddhabrot::trace(double cr, double ci, std::vector<double>& zs,
+                       std::vector<uint32_t>& out) const {
+    out.clear();
+    if (escape::in_main_bulbs(cr, ci)) return;
+
+    double zr = 0.0, zi = 0.0;
+    int n = 0;
+    while (n < maxIter && zr*zr + zi*zi <= 4.0) {
+        escape::Mandelbrot::step(zr, zi, cr, ci);
+        zs[2*n] = zr; zs[2*n + 1] = zi;
+        ++n;
+    }
+    if (n >= maxIter || n < minIter) return;
+
+    const double rS = (width - 1) / (maxRe - minRe);
+    const double iS = (height - 1) / (maxIm - minIm);
+    for (int k = 0; k < n; ++k) {
+        int px = int(std::floor((zs[2*k] - minRe) * rS + 0.5));
+        if (px < 0 || px >= width) continue;
+        // z and its conjugate (the orbit of conj c)
+        int py = int(std::floor((maxIm - zs[2*k + 1]) * iS + 0.5));
+        int pm = int(std::floor((maxIm + zs[2*k + 1]) * iS + 0.5));
+        if (py >= 0 && py < height) out.push_back(uint32_t(py) * width + px);
+        if (pm >= 0 && pm < height) out.push_back(uint32_t(pm) * width + px);
+    }
+}
+
+void Buddhabrot::accumulate(uint64_t samples, bool metropolis, uint64_t seed, int threadCount) {
+    int nThreads = threadCount > 0 ? threadCount : int(std::thread::hardware_concurrency());
+    if (nThreads <= 0) nThreads = 4;
+    if (done == 0) useMetropolis = metropolis;
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+
+    const size_t N = size_t(width) * height;
+    std::vector<std::vector<float>> hist(nThreads);
+    std::atomic<uint64_t> accepted{0}, splats{0};
+    const uint64_t base = done;
+
+    escape::split_rows(0, nThreads, nThreads, [&](int first, int last) {
+        for (int t = first; t < last; ++t) {
+            std::vector<float>& h = hist[t];
+            h.assign(N, 0.0f);
+            uint64_t count = samples * (t + 1) / nThreads - samples * t / nThreads;
+
+            // the stream depends on where the run stands, so a resumed run doesn't repeat itself
+            std::mt19937_64 rng(seed * 0x9E3779B97F4A7C15ull + base * 31 + uint64_t(t));
+            std::uniform_real_distribution<double> uni(0.0, 1.0);
+            auto random_c = [&](double& cr, double& ci) {
+                cr = -2.0 + 4.0 * uni(rng);
+                ci = -2.0 + 4.0 * uni(rng);
+            };
+
+            std::vector<double>   zs(size_t(2) * maxIter);
+            std::vector<uint32_t> cur, prop;
+            cur.reserve(size_t(2) * maxIter);
+            prop.reserve(size_t(2) * maxIter);
+            uint64_t acc = 0, spl = 0;
+
+            if (!metropolis) {
+                for (uint64_t s = 0; s < count; ++s) {
+                    double cr, ci;
+                    random_c(cr, ci);
+                    trace(cr, ci, zs, cur);
+                    for (uint32_t i : cur) h[i] += 1.0f;
+                    spl += cur.size();
+                }
+            } else {
+                // start the chain on a contributing c
+                double cr = 0.0, ci = 0.0;
+                for (int tries = 0; tries < 100000 && cur.empty(); ++tries) {
+                    random_c(cr, ci);
+                    trace(cr, ci, zs, cur);
+                }
+                const double span = maxRe - minRe;
+                for (uint64_t s = 0; s < count && !cur.empty(); ++s) {
+                    double pr, pi;
+                    if (uni(rng) < 0.2) {
+                        random_c(pr, pi);
+                    } else {
+                        // symmetric move, radius log-uniform in [1e-4, 1] x view width
+                        double r = span * std::exp(-9.21 * uni(rng));
+                        double a = 6.283185307179586 * uni(rng);
+                        pr = cr + r * std::cos(a);
+                        pi = ci + r * std::sin(a);
+                    }
+                    if (std::abs(pr) <= 2.0 && std::abs(pi) <= 2.0) {
+                        trace(pr, pi, zs, prop);
+                        if (!prop.empty() && uni(rng) * cur.size() < prop.size()) {
+                            cur.swap(prop);
+                            cr = pr; ci = pi;
+                            ++acc;
+                        }
+                    }
+                    float wgt = 1.0f / float(cur.size());
+                    for (uint32_t i : cur) h[i] += wgt;
+                    spl += cur.size();
+                }
+            }
+            accepted += acc;
+            splats   += spl;
+        }
+    });
+
+    // merge, split over rows
+    escape::split_rows(0, height, nThreads, [&](int y0, int y1) {
+        for (const auto& h : hist) {
+            if (h.empty()) continue;
+            for (size_t i = size_t(y0) * width, e = size_t(y1) * width; i < e; ++i)
+                density[i] += h[i];
+        }
+    });
+    done += samples;
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
+    std::cout << "[buddhabrot] " << samples << (metropolis ? " steps" : " orbits") << " in "
+              << ms << " ms (" << nThreads << " threads, " << splats.load() << " points";
+    if (metropolis && samples)
+        std::cout << ", " << (100.0 * accepted.load() / samples) << "% accepted";
+    std::cout << ")\n";
+}
+
+void Buddhabrot::tonemap(uint32_t* dst) const {
+    double peak = 0.0;
+    for (double v : density) peak = std::max(peak, v);
+    const double inv = peak > 0.0 ? 1.0 / peak : 0.0;
+    for (size_t i = 0; i < density.size(); ++i) {
+        uint32_t s = uint32_t(255.0 * std::sqrt(density[i] * inv) + 0.5);
+        dst[i] = 0xFF000000u | (s << 16) | (s << 8) | s;
+    }
+}
+
+// ---- checkpoints ----
+// header followed by width*height doubles, row-major; written to a temp file and
+// renamed, so a crash mid-write leaves the previous checkpoint intact
+
+struct BuddhaCheckpoint {
+    char     magic[4];     // "BDB1"
+    uint32_t width, height;
+    int32_t  maxIter, minIter;
+    uint32_t metropolis;
+    double   minRe, maxRe, minIm, maxIm;
+    uint64_t samples;
+};
+
+bool Buddhabrot::save_checkpoint(const std::string& path) const {
+    BuddhaCheckpoint c;
+    std::memcpy(c.magic, "BDB1", 4);
+    c.width = uint32_t(width); c.height = uint32_t(height);
+    c.maxIter = maxIter; c.minIter = minIter;
+    c.metropolis = useMetropolis ? 1u : 0u;
+    c.minRe = minRe; c.maxRe = maxRe; c.minIm = minIm; c.maxIm = maxIm;
+    c.samples = done;
+
+    try {
+        auto dir = std::filesystem::path(path).parent_path();
+        if (!dir.empty()) std::filesystem::create_directories(dir);
+    } catch (...) {}
+
+    std::string tmp = path + ".tmp";
+    std::FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+    bool ok = std::fwrite(&c, sizeof(c), 1, f) == 1 &&
+              std::fwrite(density.data(), sizeof(double), density.size(), f) == density.size();
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok) return false;
+
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    return !ec;
+}
+
+bool Buddhabrot::load_checkpoint(const std::string& path) {
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    BuddhaCheckpoint c;
+    bool ok = std::fread(&c, sizeof(c), 1, f) == 1
+           && std::memcmp(c.magic, "BDB1", 4) == 0
+           && c.width == uint32_t(width) && c.height == uint32_t(height)
+           && c.maxIter == maxIter && c.minIter == minIter
+           && c.minRe == minRe && c.maxRe == maxRe && c.minIm == minIm && c.maxIm == maxIm;
+    std::vector<double> d;
+    if (ok) {
+        d.resize(density.size());
+        ok = std::fread(d.data(), sizeof(double), d.size(), f) == d.size();
+    }
+    std::fclose(f);
+    if (!ok) return false;
+
+    density.swap(d);
+    done = c.samples;
+    useMetropolis = c.metropolis != 0;
+    return true;
+}
+
+// ---- CLI ----
+
+static bool ends_with(const std::string& s, const std::string& suf) {
+    return s.size() >= suf.size() && s.compare(s.size() - suf.size(), suf.size(), suf) == 0;
+}
+
+int run_buddhabrot(const BuddhaOptions& opt) {
+    if (opt.width < 2 || opt.height < 2 || opt.maxIter < 1) {
+        std::cerr << "Buddhabrot needs at least 2x2 pixels and maxIter >= 1\n";
+        return 1;
+    }
+    Buddhabrot b(opt.width, opt.height, opt.maxIter, opt.minIter);
+    if (opt.customView) b.setView(opt.minRe, opt.maxRe, opt.minIm, opt.maxIm);
+
+    if (!opt.checkpoint.empty() && std::filesystem::exists(opt.checkpoint)) {
+        if (!b.load_checkpoint(opt.checkpoint)) {
+            std::cerr << "Checkpoint " << opt.checkpoint << " is unreadable or from other settings\n";
+            return 1;
+        }
+        if (b.metropolis() != opt.metropolis) {
+            std::cerr << "Checkpoint " << opt.checkpoint << " was made "
+                      << (b.metropolis() ? "with" : "without") << " --metropolis\n";
+            return 1;
+        }
+        std::cout << "Resuming from " << opt.checkpoint << " at " << b.samples() << " samples\n";
+    }
+
+    std::cout << "Buddhabrot " << opt.width << "x" << opt.height << ", " << opt.samples
+              << (opt.metropolis ? " Metropolis steps" : " orbits") << ", iterations ["
+              << opt.minIter << ", " << opt.maxIter << ")\n";
+
+    while (b.samples() < opt.samples) {
+        uint64_t chunk = opt.samples - b.samples();
+        if (!opt.checkpoint.empty() && opt.checkpointEvery > 0)
+            chunk = std::min(chunk, opt.checkpointEvery);
+        b.accumulate(chunk, opt.metropolis, 1, opt.threads);
+        if (!opt.checkpoint.empty()) {
+            if (b.save_checkpoint(opt.checkpoint))
+                std::cout << "Checkpoint " << opt.checkpoint << " (" << b.samples() << " samples)\n";
+            else
+                std::cerr << "Failed to write checkpoint " << opt.checkpoint << "\n";
+        }
+    }
+
+    std::vector<uint32_t> img(size_t(opt.width) * opt.height);
+    b.tonemap(img.data());
+    if (ends_with(opt.path, ".qoi"))      save_qoi_from_buffer(img.data(), opt.width, opt.height, opt.path);
+    else if (ends_with(opt.path, ".bmp")) save_bmp_from_buffer(img.data(), opt.width, opt.height, opt.path);
+    else                                  save_png_from_buffer(img.data(), opt.width, opt.height, opt.path);
+    return 0;
+}
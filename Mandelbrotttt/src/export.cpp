@@ -0,0 +1,220 @@
+#include "export.h"
+#include "mandelbrot.h"
+#include "image_save.h"
+#include "field.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static bool ends_with(const std::string& s, const std::string& suf) {
+    if (s.size() < suf.size()) return false;
+    return std::equal(suf.rbegin(), suf.rend(), s.rbegin(),
+                      [](char a, char b) { return std::tolower((unsigned char)a) == b; });
+}
+
+static void ensure_parent(const std::string& path) {
+    try {
+        std::filesystem::path p(path);
+        auto dir = p.parent_path();
+        if (!dir.empty() && !std::filesystem::exists(dir)) {
+            std::filesystem::create_directories(dir);
+        }
+    } catch (...) {}
+}
+
+static void render_band(const Fractal& f, const ExportOptions& opt, uint32_t* dst, int y0, int y1) {
+    if (opt.de && f.compute_rows_de(dst, y0, y1, opt.threads)) return;
+    if (opt.aa > 1 && opt.aaDe > 0) f.compute_rows_aa_de(dst, y0, y1, opt.aa, opt.aaDe, opt.threads);
+    else if (opt.aa > 1)            f.compute_rows_aa(dst, y0, y1, opt.aa, opt.aaThreshold, opt.threads);
+    else                            f.compute_rows(dst, y0, y1, opt.threads);
+}
+
+// PNG/QOI rows go bottom-up (file row j = pixel row h-1-j), so bands are rendered from the bottom
+template <class Writer>
+static bool export_stream(const Fractal& f, const ExportOptions& opt, int bandRows, Writer& out) {
+    const int w = opt.width, h = opt.height;
+    std::vector<uint32_t> band(size_t(w) * bandRows);
+
+    for (int y1 = h; y1 > 0 && out.ok(); y1 -= bandRows) {
+        int y0 = std::max(0, y1 - bandRows);
+        render_band(f, opt, band.data(), y0, y1);
+        out.write_rows(band.data() + size_t(y1 - y0 - 1) * w, y1 - y0, -(long long)w);
+        std::cout << "\r[export] " << (h - y0) << " / " << h << " rows" << std::flush;
+    }
+    std::cout << "\n";
+    return out.finish();
+}
+
+static bool export_png(const Fractal& f, const ExportOptions& opt, int bandRows) {
+    PngOptions po = png_options();
+    po.threads = opt.threads;
+    PngWriter png(opt.path, opt.width, opt.height, po);
+    return export_stream(f, opt, bandRows, png);
+}
+
+static bool export_qoi(const Fractal& f, const ExportOptions& opt, int bandRows) {
+    QoiWriter qoi(opt.path, opt.width, opt.height);
+    return export_stream(f, opt, bandRows, qoi);
+}
+
+static bool export_field(const Fractal& f, const ExportOptions& opt, int bandRows) {
+    const int w = opt.width, h = opt.height;
+    std::vector<uint32_t> iters(opt.smooth ? 0 : size_t(w) * bandRows);
+    std::vector<float>    smooth(opt.smooth ? size_t(w) * bandRows : 0);
+
+    FieldHeader meta = {};
+    meta.width       = uint32_t(w);
+    meta.height      = uint32_t(h);
+    meta.sample      = opt.smooth ? FIELD_SMOOTH_F32 : FIELD_ITER_U32;
+    meta.compression = opt.compress ? FIELD_DELTA_VARINT : FIELD_RAW;
+    meta.maxIter     = f.getMaxIter();
+    meta.fractal     = uint32_t(f.getFormula()) << 1;
+    meta.minRe = f.minRe; meta.maxRe = f.maxRe;
+    meta.minIm = f.minIm; meta.maxIm = f.maxIm;
+    FieldWriter out(opt.path, meta);
+
+    for (int y0 = 0; y0 < h && out.ok(); y0 += bandRows) {
+        int y1 = std::min(h, y0 + bandRows);
+        f.compute_field(opt.smooth ? nullptr : iters.data(),
+                        opt.smooth ? smooth.data() : nullptr, y0, y1, opt.threads);
+        out.write_rows(opt.smooth ? (const void*)smooth.data() : iters.data(), y1 - y0);
+        std::cout << "\r[export] " << y1 << " / " << h << " rows" << std::flush;
+    }
+    std::cout << "\n";
+    return out.finish();
+}
+
+static bool export_raw(const Fractal& f, const ExportOptions& opt, int bandRows) {
+    const int w = opt.width, h = opt.height;
+    std::vector<uint32_t> band(size_t(w) * bandRows);
+
+    std::FILE* out = std::fopen(opt.path.c_str(), "wb");
+    if (!out) return false;
+    bool ok = true;
+    for (int y0 = 0; y0 < h && ok; y0 += bandRows) {
+        int y1 = std::min(h, y0 + bandRows);
+        render_band(f, opt, band.data(), y0, y1);
+        size_t n = size_t(y1 - y0) * w;
+        ok = std::fwrite(band.data(), sizeof(uint32_t), n, out) == n;
+        std::cout << "\r[export] " << y1 << " / " << h << " rows" << std::flush;
+    }
+    std::cout << "\n";
+    return (std::fclose(out) == 0) && ok;
+}
+
+// Same layout as export_raw, but each band is mapped from the file and rendered
+// in place: no band buffer and no write() copy; the OS flushes pages as it likes.
+static bool export_mmap(const Fractal& f, const ExportOptions& opt, int bandRows) {
+    const int w = opt.width, h = opt.height;
+    const unsigned long long total = (unsigned long long)w * h * sizeof(uint32_t);
+    const size_t rowBytes = size_t(w) * sizeof(uint32_t);
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(opt.path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+                              CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    HANDLE map = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+                                    DWORD(total >> 32), DWORD(total & 0xFFFFFFFFu), nullptr);
+    if (!map) { CloseHandle(file); return false; }
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    const unsigned long long gran = si.dwAllocationGranularity;
+#else
+    int fd = ::open(opt.path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    if (::ftruncate(fd, off_t(total)) != 0) { ::close(fd); return false; }
+    const unsigned long long gran = (unsigned long long)sysconf(_SC_PAGESIZE);
+#endif
+
+    bool ok = true;
+    for (int y0 = 0; y0 < h && ok; y0 += bandRows) {
+        int y1 = std::min(h, y0 + bandRows);
+        unsigned long long off   = (unsigned long long)y0 * rowBytes;
+        unsigned long long base  = off - off % gran; // mapping offsets must be aligned
+        size_t             delta = size_t(off - base);
+        size_t             len   = delta + size_t(y1 - y0) * rowBytes;
+
+#ifdef _WIN32
+        void* p = MapViewOfFile(map, FILE_MAP_WRITE, DWORD(base >> 32), DWORD(base & 0xFFFFFFFFu), len);
+        if (!p) { ok = false; break; }
+        render_band(f, opt, reinterpret_cast<uint32_t*>(static_cast<char*>(p) + delta), y0, y1);
+        UnmapViewOfFile(p);
+#else
+        void* p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, off_t(base));
+        if (p == MAP_FAILED) { ok = false; break; }
+        render_band(f, opt, reinterpret_cast<uint32_t*>(static_cast<char*>(p) + delta), y0, y1);
+        ::munmap(p, len);
+#endif
+        std::cout << "\r[export] " << y1 << " / " << h << " rows" << std::flush;
+    }
+    std::cout << "\n";
+
+#ifdef _WIN32
+    CloseHandle(map);
+    CloseHandle(file);
+#else
+    ok = (::close(fd) == 0) && ok;
+#endif
+    return ok;
+}
+
+int run_export(const ExportOptions& opt) {
+    if (opt.width <= 1 || opt.height <= 1 || opt.path.empty()) {
+        std::cerr << "Export needs WIDTH HEIGHT and an output path.\n";
+        return 1;
+    }
+    ensure_parent(opt.path);
+
+    int bandRows = opt.bandRows;
+    if (bandRows <= 0) bandRows = int(std::max<size_t>(1, (64u << 20) / (size_t(opt.width) * 4)));
+    bandRows = std::min(bandRows, opt.height);
+
+    // viewport only; no width*height buffer
+    Fractal f(opt.width, opt.height, false);
+    f.setFormula(opt.formula);
+    f.setPrecision(opt.precision);
+
+    if ((opt.de || opt.aaDe > 0) && !escape::has_distance(opt.formula))
+        std::cerr << "No distance estimate for " << escape::formula_name(opt.formula)
+                  << ", using the plain " << (opt.de ? "gray view" : "neighbour test") << "\n";
+
+    bool png = ends_with(opt.path, ".png");
+    bool qoi = ends_with(opt.path, ".qoi");
+    bool itf = ends_with(opt.path, ".itf");
+    std::cout << "Exporting " << opt.width << "x" << opt.height << " to " << opt.path
+              << (png ? " (png" : qoi ? " (qoi" : itf ? " (field" : opt.mmap ? " (raw, mmap" : " (raw")
+              << ", " << escape::formula_name(opt.formula) << ", " << bandRows << " rows/band";
+    if (opt.de) std::cout << ", distance line art";
+    else if (opt.aa > 1) std::cout << ", adaptive AA " << opt.aa << "x" << opt.aa
+                                   << (opt.aaDe > 0 ? " (distance-guided)" : "");
+    std::cout << ")\n";
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+    bool ok = png      ? export_png(f, opt, bandRows)
+            : qoi      ? export_qoi(f, opt, bandRows)
+            : itf      ? export_field(f, opt, bandRows)
+            : opt.mmap ? export_mmap(f, opt, bandRows)
+            :            export_raw(f, opt, bandRows);
+    auto t1 = std::chrono::high_resolution_clock::now();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
+
+    if (!ok) {
+        std::cerr << "Export failed: " << opt.path << "\n";
+        return 1;
+    }
+    std::cout << "Saved " << opt.path << " (" << ms << " ms)\n";
+    return 0;
+}
@@ -0,0 +1,211 @@
+#include "field.h"
+
+#include <climits>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static void ensure_parent(const std::string& path) {
+    try {
+        std::filesystem::path p(path);
+        auto dir = p.parent_path();
+        if (!dir.empty() && !std::filesystem::exists(dir)) {
+            std::filesystem::create_directories(dir);
+        }
+    } catch (...) {}
+}
+
+// ---- row codec: delta of the 32-bit sample patterns, zigzag, LEB128 ----
+
+// samples go through memcpy: they may be float bits
+static void encode_row(const uint8_t* s, int w, std::vector<uint8_t>& out) {
+    uint32_t prev = 0;
+    for (int x = 0; x < w; ++x) {
+        uint32_t v;
+        std::memcpy(&v, s + size_t(x) * 4, 4);
+        int32_t  d = int32_t(v - prev);
+        uint32_t z = (uint32_t(d) << 1) ^ uint32_t(d >> 31);
+        prev = v;
+        while (z >= 0x80) { out.push_back(uint8_t(z | 0x80)); z >>= 7; }
+        out.push_back(uint8_t(z));
+    }
+}
+
+static bool decode_row(const uint8_t* p, const uint8_t* end, uint8_t* s, int w) {
+    uint32_t prev = 0;
+    for (int x = 0; x < w; ++x) {
+        uint32_t z = 0;
+        int shift = 0;
+        for (;;) {
+            if (p >= end || shift > 28) return false;
+            uint8_t b = *p++;
+            z |= uint32_t(b & 0x7F) << shift;
+            if (!(b & 0x80)) break;
+            shift += 7;
+        }
+        int32_t d = int32_t(z >> 1) ^ -int32_t(z & 1);
+        prev += uint32_t(d);
+        std::memcpy(s + size_t(x) * 4, &prev, 4);
+    }
+    return true;
+}
+
+// ---- writer ----
+
+FieldWriter::FieldWriter(const std::string& path, const FieldHeader& meta)
+  : f(nullptr), hdr(meta), good(true), rowsDone(0)
+{
+    std::memcpy(hdr.magic, "ITF1", 4);
+    hdr.headerSize  = sizeof(FieldHeader);
+    hdr.dataOffset  = sizeof(FieldHeader);
+    hdr.dataSize    = 0;
+    hdr.indexOffset = 0;
+    std::memset(hdr.reserved, 0, sizeof(hdr.reserved));
+    if (hdr.compression == FIELD_DELTA_VARINT) rowOffsets.push_back(0);
+
+    ensure_parent(path);
+    f = std::fopen(path.c_str(), "wb");
+    if (!f) { good = false; return; }
+    good = std::fwrite(&hdr, sizeof(hdr), 1, f) == 1; // patched in finish()
+}
+
+FieldWriter::~FieldWriter() {
+    if (f) std::fclose(f);
+}
+
+bool FieldWriter::write_rows(const void* rows, int count) {
+    if (!good) return false;
+    const uint8_t* s = static_cast<const uint8_t*>(rows);
+    const int w = int(hdr.width);
+
+    if (hdr.compression == FIELD_DELTA_VARINT) {
+        for (int j = 0; j < count; ++j) {
+            enc.clear();
+            encode_row(s + size_t(j) * w * 4, w, enc);
+            good = good && std::fwrite(enc.data(), 1, enc.size(), f) == enc.size();
+            hdr.dataSize += enc.size();
+            rowOffsets.push_back(hdr.dataSize);
+        }
+    } else {
+        size_t n = size_t(count) * w;
+        good = std::fwrite(s, 4, n, f) == n;
+        hdr.dataSize += n * sizeof(uint32_t);
+    }
+    rowsDone += count;
+    return good;
+}
+
+bool FieldWriter::finish() {
+    if (!f) return false;
+    if (rowsDone != int(hdr.height)) good = false;
+
+    if (good && hdr.compression == FIELD_DELTA_VARINT) {
+        hdr.indexOffset = hdr.dataOffset + hdr.dataSize;
+        good = std::fwrite(rowOffsets.data(), sizeof(uint64_t), rowOffsets.size(), f) == rowOffsets.size();
+    }
+    good = good && std::fseek(f, 0, SEEK_SET) == 0
+                && std::fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    good = (std::fclose(f) == 0) && good;
+    f = nullptr;
+    return good;
+}
+
+// ---- reader ----
+
+FieldReader::FieldReader(const std::string& path) {
+#ifdef _WIN32
+    HANDLE fh = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fh == INVALID_HANDLE_VALUE) return;
+    LARGE_INTEGER sz;
+    if (!GetFileSizeEx(fh, &sz) || sz.QuadPart < LONGLONG(sizeof(FieldHeader))) { CloseHandle(fh); return; }
+    HANDLE mh = CreateFileMappingA(fh, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mh) { CloseHandle(fh); return; }
+    void* p = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+    if (!p) { CloseHandle(mh); CloseHandle(fh); return; }
+    file = fh; map = mh;
+    size = uint64_t(sz.QuadPart);
+#else
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || uint64_t(st.st_size) < sizeof(FieldHeader)) { ::close(fd); fd = -1; return; }
+    void* p = ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) { ::close(fd); fd = -1; return; }
+    size = uint64_t(st.st_size);
+#endif
+    base = static_cast<const uint8_t*>(p);
+
+    // sanity-check before anyone trusts the header
+    const FieldHeader& h = header();
+    uint64_t rawSize = uint64_t(h.width) * h.height * 4;
+    // readers cast width / height to int, and a 0 would pass the size checks below
+    bool valid = std::memcmp(h.magic, "ITF1", 4) == 0
+              && h.headerSize == sizeof(FieldHeader)
+              && h.width > 0 && h.width <= uint32_t(INT_MAX)
+              && h.height > 0 && h.height <= uint32_t(INT_MAX)
+              // offsets straight from the file: compare against what's left, so they can't wrap
+              && h.dataOffset <= size && h.dataSize <= size - h.dataOffset
+              && (h.compression == FIELD_RAW
+                      ? h.dataSize == rawSize
+                      : h.compression == FIELD_DELTA_VARINT
+                        && h.indexOffset <= size
+                        && (uint64_t(h.height) + 1) * 8 <= size - h.indexOffset);
+    if (!valid) {
+#ifdef _WIN32
+        UnmapViewOfFile(p); CloseHandle(mh); CloseHandle(fh);
+        file = map = nullptr;
+#else
+        ::munmap(p, size_t(size)); ::close(fd); fd = -1;
+#endif
+        base = nullptr;
+    }
+}
+
+FieldReader::~FieldReader() {
+    if (!base) return;
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+    CloseHandle(map);
+    CloseHandle(file);
+#else
+    ::munmap(const_cast<uint8_t*>(base), size_t(size));
+    ::close(fd);
+#endif
+}
+
+const void* FieldReader::samples() const {
+    if (!base || header().compression != FIELD_RAW) return nullptr;
+    return base + header().dataOffset;
+}
+
+bool FieldReader::read_rows(int y0, int y1, void* dst) const {
+    if (!base || y0 < 0 || y1 > int(header().height) || y0 > y1) return false;
+    const FieldHeader& h = header();
+    const int w = int(h.width);
+    uint8_t* out = static_cast<uint8_t*>(dst);
+
+    if (h.compression == FIELD_RAW) {
+        std::memcpy(out, base + h.dataOffset + uint64_t(y0) * w * 4, size_t(y1 - y0) * w * 4);
+        return true;
+    }
+
+    const uint8_t* data = base + h.dataOffset;
+    const uint8_t* idx  = base + h.indexOffset;
+    for (int y = y0; y < y1; ++y) {
+        uint64_t a, b;
+        std::memcpy(&a, idx + size_t(y) * 8, 8);
+        std::memcpy(&b, idx + size_t(y + 1) * 8, 8);
+        if (a > b || b > h.dataSize) return false;
+        if (!decode_row(data + a, data + b, out + size_t(y - y0) * w * 4, w)) return false;
+    }
+    return true;
+}
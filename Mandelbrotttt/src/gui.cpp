@@ -1,18 +1,37 @@
 #include "gui.h"
 #include "image_save.h"
+#include "font5x7.h"
+#include "metrics.h"
+#include "trace.h"
+#include <chrono>
 #include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
 
-Gui::Gui(int w, int h, bool gpu, bool single)
-  : width(w), height(h), useGPU(gpu), useSingle(single),
-    mandel(width, height), julia(width, height) {}
+Gui::Gui(int w, int h, bool single, bool refine)
+  : width(w), height(h), useSingle(single), refine(refine),
+    mandel(width, height), julia(width, height),
+    insetW(std::max(1, w / insetDiv)), insetH(std::max(1, h / insetDiv))
+{
+    mandel.setKeepOrbits(true);   // lets I raise maxIter without a full re-render
+}
 
 Gui::~Gui() {
+    cancelInset();
+    if (lastSave.valid()) lastSave.wait();
+    if (hudTex)   SDL_DestroyTexture(hudTex);
     if (texture)  SDL_DestroyTexture(texture);
     if (renderer) SDL_DestroyRenderer(renderer);
     if (window)   SDL_DestroyWindow(window);
     SDL_Quit();
 }
 
+void Gui::setFormula(escape::Formula f, escape::Precision p) {
+    mandel.setFormula(f); mandel.setPrecision(p);
+    julia.setFormula(f);  julia.setPrecision(p);
+}
+
 bool Gui::initSDL() {
     // SDL3: SDL_Init returns bool (true on success, false on failure)
     if (!SDL_Init(SDL_INIT_VIDEO)) {
@@ -39,14 +58,29 @@ bool Gui::initSDL() {
         return false;
     }
 
+    hudTex = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                               SDL_TEXTUREACCESS_STREAMING, hudW, hudH);
+    if (hudTex) SDL_SetTextureBlendMode(hudTex, SDL_BLENDMODE_BLEND);
+
     return true;
 }
 
+// when a key / wheel event happened (SDL3 stamps events on the SDL_GetTicksNS
+// clock); 0 for events that aren't timed
+static Uint64 input_time(const SDL_Event& e) {
+    Uint64 t;
+    if (e.type == SDL_EVENT_KEY_DOWN)         t = e.key.timestamp;
+    else if (e.type == SDL_EVENT_MOUSE_WHEEL) t = e.wheel.timestamp;
+    else return 0;
+    return t ? t : SDL_GetTicksNS();
+}
+
 int Gui::run() {
     if (!initSDL()) return 1;
+    trace::name_thread("main");
 
     SDL_SetWindowTitle(window,
-        "B=Save BMP  P=Save PNG  T=Toggle Julia/Mandelbrot  Scroll=Zoom  WASD=Pan"
+        "B=Save BMP  P=Save PNG  Q=Save QOI  T=Toggle Julia/Mandelbrot  J=Explore Julia c  F=Formula  H=HUD  R=Trace  Scroll=Zoom  WASD=Pan"
     );
 
     renderCurrent();
@@ -58,25 +92,76 @@ int Gui::run() {
             if (e.type == SDL_EVENT_QUIT) {
                 quit = true;
             } else {
+                lastInput = SDL_GetTicks();
+                inputAt   = input_time(e);
                 handleEvent(e);
+                inputAt   = 0;
             }
         }
-        SDL_Delay(10);
+        bool busy = refineStep();
+        busy = exploreStep() || busy;
+        if (!busy) SDL_Delay(explore ? 2 : 10);
     }
+
+    latency.print();
+    if (!latencyOut.empty()) latency.write(latencyOut);
     return 0;
 }
 
 void Gui::handleEvent(const SDL_Event& e) {
+    trace::Span span("gui", "event");
+    // any input may touch the Julia state the inset worker reads
+    cancelInset();
+
     switch (e.type) {
     case SDL_EVENT_KEY_DOWN: {
         auto sc = e.key.scancode;
         if (sc == SDL_SCANCODE_T) {
             showJulia = !showJulia;
             renderCurrent();
+        } else if (sc == SDL_SCANCODE_F) {
+            auto f = escape::Formula((int(mandel.getFormula()) + 1) % 5);
+            mandel.setFormula(f);
+            julia.setFormula(f);
+            std::cout << "Formula: " << escape::formula_name(f) << "\n";
+            renderCurrent();
+        } else if (sc == SDL_SCANCODE_J) {
+            explore = !explore;
+            std::cout << "Julia explorer " << (explore ? "on" : "off") << "\n";
+            insetPix.assign(size_t(insetW) * insetH, 0xFF000000u);
+            previewDirty = explore;
+            if (!showJulia && frame) present(frame);
+        } else if (sc == SDL_SCANCODE_M) {
+            julia.setBoundary(!julia.getBoundary());
+            std::cout << "Julia line art " << (julia.getBoundary() ? "on" : "off") << "\n";
+            if (showJulia) renderCurrent();
+        } else if (sc == SDL_SCANCODE_E) {
+            julia.setDistance(!julia.getDistance());
+            std::cout << "Julia distance estimate " << (julia.getDistance() ? "on" : "off") << "\n";
+            if (showJulia) renderCurrent();
+        } else if ((sc == SDL_SCANCODE_I || sc == SDL_SCANCODE_U) && !showJulia) {
+            // I doubles the Mandelbrot iteration limit (continuing only unescaped pixels),
+            // U goes back to the default
+            int n = sc == SDL_SCANCODE_I ? mandel.getMaxIter() * 2 : Fractal::defaultMaxIter;
+            if (n != mandel.getMaxIter()) {
+                resetRefine();
+                mandel.raise_max_iter(n, useSingle ? 1 : 0);
+                std::cout << "maxIter: " << n << "\n";
+                present(mandel.data());
+            }
         } else if (sc == SDL_SCANCODE_B) {
             saveBMP("fractal.bmp");
         } else if (sc == SDL_SCANCODE_P) {
             savePNG("fractal.png");
+        } else if (sc == SDL_SCANCODE_Q) {
+            saveQOI("fractal.qoi");
+        } else if (sc == SDL_SCANCODE_H) {
+            showHud = !showHud;
+            present(showJulia ? julia.data() : frame ? frame : mandel.data());
+        } else if (sc == SDL_SCANCODE_R) {
+            // R starts a trace, R again writes it (stop() prints where)
+            if (trace::active()) trace::stop();
+            else if (trace::start("img/trace.json")) std::cout << "Tracing to img/trace.json (R to stop)\n";
         } else if (sc == SDL_SCANCODE_W) {
             if (showJulia) julia.pan(0,-1); else mandel.pan(0,-1);
             renderCurrent();
@@ -92,6 +177,16 @@ void Gui::handleEvent(const SDL_Event& e) {
         }
         break;
     }
+    case SDL_EVENT_MOUSE_MOTION: {
+        if (explore && !showJulia) {
+            double cre = mandel.minRe + e.motion.x * mandel.reFactor;
+            double cim = mandel.maxIm - e.motion.y * mandel.imFactor;
+            julia.setConstant(cre, cim);
+            previewDirty = true;
+            lastMotion   = SDL_GetTicks();
+        }
+        break;
+    }
     case SDL_EVENT_MOUSE_WHEEL: {
         if (showJulia) {
             julia.zoomAt(e.wheel.mouse_x, e.wheel.mouse_y, e.wheel.y);
@@ -109,23 +204,233 @@ void Gui::handleEvent(const SDL_Event& e) {
 }
 
 void Gui::renderCurrent() {
+    trace::Span span("gui", "render");
+    resetRefine();
+    // compute here and present through present(), so the inset and the HUD go on top
+    int threads = useSingle ? 1 : 0;   // 0 = auto threads
     if (showJulia) {
-        julia.render(renderer, texture);
-    } else if (useGPU) {
-        mandel.render_gpu(renderer, texture);
-    } else if (useSingle) {
-        mandel.render_cpu(renderer, texture, 1);
+        julia.update(threads);
+        present(julia.data());
     } else {
-        mandel.render_cpu(renderer, texture, 0); // auto threads
+        mandel.compute_only(threads);
+        present(mandel.data());
     }
 }
 
+void Gui::present(const uint32_t* pix) {
+    trace::Span span("gui", "present");
+    if (!showJulia) frame = pix;
+    if (explore && !showJulia && !insetPix.empty()) {
+        // inset in the top-right corner with a 1px white border
+        framed.assign(pix, pix + size_t(width) * height);
+        int x0 = width - insetW - 8, y0 = 8;
+        for (int y = std::max(0, y0 - 1); y < std::min(height, y0 + insetH + 1); ++y) {
+            for (int x = std::max(0, x0 - 1); x < std::min(width, x0 + insetW + 1); ++x) {
+                bool inside = x >= x0 && x < x0 + insetW && y >= y0 && y < y0 + insetH;
+                framed[size_t(y) * width + x] = inside
+                    ? insetPix[size_t(y - y0) * insetW + (x - x0)] : 0xFFFFFFFFu;
+            }
+        }
+        pix = framed.data();
+    }
+    Uint64 ready = SDL_GetTicksNS();
+    SDL_UpdateTexture(texture, nullptr, pix, width * sizeof(uint32_t));
+    Uint64 uploaded = SDL_GetTicksNS();
+    uploadMs = double(uploaded - ready) / 1e6;
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    SDL_SetRenderDrawColor(renderer, 0,0,0,255);
+    SDL_RenderClear(renderer);
+    SDL_RenderTexture(renderer, texture, nullptr, nullptr);
+    if (showHud) drawHud();
+    SDL_RenderPresent(renderer);
+    if (inputAt) {
+        latency.record(inputAt, ready, uploaded, SDL_GetTicksNS());
+        inputAt = 0;
+    }
+}
+
+void Gui::drawHud() {
+    if (!hudTex) return;
+    const metrics::Frame f = metrics::last();
+    double span  = showJulia ? julia.maxRe - julia.minRe : mandel.maxRe - mandel.minRe;
+    int    limit = showJulia ? Julia::maxIter : mandel.getMaxIter();
+    uint64_t px  = f.computed + f.reused;
+
+    char text[256];
+    std::snprintf(text, sizeof(text),
+        "COMPUTE %7.1f MS\nUPLOAD  %7.2f MS\nMITER/S %7.0f\nTHREADS %d\nZOOM    %.3gX\n"
+        "MAXITER %d\nREUSED  %.0f%%",
+        f.wallMs, uploadMs, f.wallMs > 0 ? f.iterations / (f.wallMs * 1e3) : 0.0, f.threads,
+        3.0 / span, limit, px ? 100.0 * f.reused / px : 0.0);
+
+    hudPix.assign(size_t(hudW) * hudH, 0xB0000000u);   // translucent black
+    draw_text_rgba(hudPix.data(), hudW, hudH, 6, 5, text, 0xFFFFFFFFu, hudScale);
+    SDL_UpdateTexture(hudTex, nullptr, hudPix.data(), hudW * sizeof(uint32_t));
+
+    // top-left; the explorer inset is top-right
+    SDL_FRect dst = { 8.0f, 8.0f, float(hudW), float(hudH) };
+    SDL_RenderTexture(renderer, hudTex, nullptr, &dst);
+}
+
+void Gui::resetRefine() {
+    accumSamples = 0;
+    refineRow    = 0;
+    lastInput    = SDL_GetTicks();
+}
+
+// radical inverse, for well-spread subpixel offsets
+static double halton(int i, int base) {
+    double f = 1.0, r = 0.0;
+    for (; i > 0; i /= base) {
+        f /= base;
+        r += f * (i % base);
+    }
+    return r;
+}
+
+// Does one slice of refinement work if the viewer is idle; false when there was nothing to do
+bool Gui::refineStep() {
+    if (!refine || showJulia || accumSamples >= refineMaxSamples) return false;
+    Uint64 now = SDL_GetTicks();
+    if (now - lastInput < Uint64(refineIdleMs)) return false;
+
+    const size_t n = size_t(width) * height;
+    if (accumSamples == 0 && refineRow == 0) {
+        // the frame on screen is sample 0
+        accum.resize(n * 3);
+        const uint32_t* p = mandel.data();
+        for (size_t i = 0; i < n; ++i) {
+            accum[3*i + 0] = float((p[i] >> 16) & 0xFF);
+            accum[3*i + 1] = float((p[i] >> 8) & 0xFF);
+            accum[3*i + 2] = float(p[i] & 0xFF);
+        }
+        accumSamples = 1;
+        lastPresent  = now;
+    }
+
+    // one band of the next jittered pass; band height adapts to refineSliceMs
+    trace::Span span("gui", "refine", refineRow, std::min(height, refineRow + refineBand));
+    int  s  = accumSamples;
+    double jx = halton(s, 2) - 0.5, jy = halton(s, 3) - 0.5;
+    int  y0 = refineRow, y1 = std::min(height, refineRow + refineBand);
+    sampleBuf.resize(size_t(width) * refineBand);
+
+    Uint64 t0 = SDL_GetTicks();
+    mandel.compute_rows_jittered(sampleBuf.data(), y0, y1, jx, jy, useSingle ? 1 : 0);
+    Uint64 dt = SDL_GetTicks() - t0;
+    if (dt < Uint64(refineSliceMs) / 2)  refineBand = std::min(height, refineBand * 2);
+    else if (dt > Uint64(refineSliceMs)) refineBand = std::max(1, refineBand / 2);
+
+    float* a = &accum[size_t(y0) * width * 3];
+    for (size_t i = 0, m = size_t(y1 - y0) * width; i < m; ++i) {
+        uint32_t c = sampleBuf[i];
+        a[3*i + 0] += float((c >> 16) & 0xFF);
+        a[3*i + 1] += float((c >> 8) & 0xFF);
+        a[3*i + 2] += float(c & 0xFF);
+    }
+
+    refineRow = y1;
+    if (refineRow >= height) {
+        refineRow = 0;
+        ++accumSamples;
+
+        now = SDL_GetTicks();
+        if (now - lastPresent >= Uint64(refinePresentMs) || accumSamples >= refineMaxSamples) {
+            shown.resize(n);
+            float inv = 1.0f / float(accumSamples);
+            for (size_t i = 0; i < n; ++i) {
+                uint32_t r = uint32_t(accum[3*i + 0] * inv + 0.5f);
+                uint32_t g = uint32_t(accum[3*i + 1] * inv + 0.5f);
+                uint32_t b = uint32_t(accum[3*i + 2] * inv + 0.5f);
+                shown[i] = 0xFF000000u | (r << 16) | (g << 8) | b;
+            }
+            present(shown.data());
+            lastPresent = now;
+        }
+    }
+    return true;
+}
+
+void Gui::cancelInset() {
+    if (!insetJob.valid()) return;
+    insetCancel = true;
+    if (insetJob.get()) insetPix.swap(insetFull);
+    else                insetSharp = false;   // cancelled: request it again later
+    insetCancel = false;
+}
+
+// Coarse preview while the cursor moves, full-res inset once it rests; false when idle
+bool Gui::exploreStep() {
+    if (!explore || showJulia) return false;
+    Uint64 now = SDL_GetTicks();
+
+    if (insetJob.valid() &&
+        insetJob.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        if (insetJob.get()) {
+            insetPix.swap(insetFull);
+            if (frame) present(frame);
+        } else {
+            insetSharp = false;
+        }
+    }
+
+    if (previewDirty) {
+        if (now - lastPreview < Uint64(exploreFrameMs)) return false;
+        trace::Span span("gui", "coarse_preview");
+        int cw = std::max(1, insetW / coarseDiv), ch = std::max(1, insetH / coarseDiv);
+        coarse.resize(size_t(cw) * ch);
+        julia.compute_preview(coarse.data(), cw, ch, useSingle ? 1 : 0);
+        insetPix.resize(size_t(insetW) * insetH);
+        for (int y = 0; y < insetH; ++y) {
+            const uint32_t* src = &coarse[size_t(std::min(ch - 1, y * ch / insetH)) * cw];
+            for (int x = 0; x < insetW; ++x)
+                insetPix[size_t(y) * insetW + x] = src[std::min(cw - 1, x * cw / insetW)];
+        }
+        if (frame) present(frame);
+        previewDirty = false;
+        insetSharp   = false;
+        lastPreview  = now;
+        return true;
+    }
+
+    if (!insetSharp && !insetJob.valid() && now - lastMotion >= Uint64(exploreRestMs)) {
+        insetFull.resize(size_t(insetW) * insetH);
+        int threads = useSingle ? 1 : 0;
+        insetJob = std::async(std::launch::async, [this, threads]() {
+            trace::name_thread("inset");
+            return julia.compute_preview(insetFull.data(), insetW, insetH, threads, &insetCancel);
+        });
+        insetSharp = true;
+    }
+    return false;
+}
+
+void Gui::saveAsync(void (*writer)(const uint32_t*, int, int, const std::string&),
+                    const std::string& path) {
+    // The viewer may re-render while the encoder runs, so it works on a copy
+    const uint32_t* buf = showJulia ? julia.data() : mandel.data();
+    std::vector<uint32_t> snap(buf, buf + size_t(width) * height);
+    int w = width, h = height;
+    lastSave = std::async(std::launch::async,
+        [writer, path, w, h, snap = std::move(snap), prev = lastSave]() mutable {
+            trace::name_thread("save");
+            if (prev.valid()) prev.wait();
+            writer(snap.data(), w, h, path);
+            // the shared state keeps this lambda alive, so let go of the frame and
+            // of the previous save (and its frame) here
+            prev = {};
+            std::vector<uint32_t>().swap(snap);
+        }).share();
+}
+
 void Gui::saveBMP(const std::string& fn) {
-    auto buf = showJulia ? julia.data() : mandel.data();
-    save_bmp_from_buffer(buf, width, height, std::string("img/") + fn);
+    saveAsync(save_bmp_from_buffer, std::string("img/") + fn);
 }
 
 void Gui::savePNG(const std::string& fn) {
-    auto buf = showJulia ? julia.data() : mandel.data();
-    save_png_from_buffer(buf, width, height, std::string("img/") + fn);
+    saveAsync(save_png_from_buffer, std::string("img/") + fn);
+}
+
+void Gui::saveQOI(const std::string& fn) {
+    saveAsync(save_qoi_from_buffer, std::string("img/") + fn);
 }
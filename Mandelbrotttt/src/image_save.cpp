@@ -1,10 +1,16 @@
 #include "image_save.h"
+#include "trace.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 #include <vector>
 #include <cstring>
 #include <iostream>
 #include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
 
 static void ensure_parent(const std::string& path) {
     try {
@@ -16,27 +22,586 @@ static void ensure_parent(const std::string& path) {
     } catch (...) {}
 }
 
+static void put_le16(uint8_t* p, uint32_t v) { p[0] = uint8_t(v); p[1] = uint8_t(v >> 8); }
+static void put_le32(uint8_t* p, uint32_t v) { put_le16(p, v); put_le16(p + 2, v >> 16); }
+
+// 32-bit BI_BITFIELDS BMP with a V4 header. The masks describe ARGB8888 as it
+// sits in memory, and BMP rows are stored bottom-up, so the pixel buffer goes
+// out in one fwrite, no temporary (pixel row 0 ends up at the bottom, same
+// orientation the stb path used to produce).
 void save_bmp_from_buffer(const uint32_t* pixels, int w, int h, const std::string& path) {
+    trace::Span span("image", "save_bmp");
     ensure_parent(path);
-    std::vector<uint8_t> buf(w * h * 4);
-    // Flip vertically for conventional top-left origin
-    for (int y = 0; y < h; ++y) {
-        std::memcpy(&buf[(h-1-y) * w * 4], &pixels[y * w], w * 4);
+
+    const uint32_t hdrSize  = 14 + 108;
+    const uint64_t dataSize = uint64_t(w) * h * 4;
+    uint8_t hdr[hdrSize] = {};
+
+    hdr[0] = 'B'; hdr[1] = 'M';
+    put_le32(hdr + 2,  uint32_t(std::min<uint64_t>(hdrSize + dataSize, 0xFFFFFFFFu)));
+    put_le32(hdr + 10, hdrSize);             // pixel data offset
+
+    uint8_t* v4 = hdr + 14;                  // BITMAPV4HEADER
+    put_le32(v4 + 0,  108);
+    put_le32(v4 + 4,  uint32_t(w));
+    put_le32(v4 + 8,  uint32_t(h));          // positive height = bottom-up rows
+    put_le16(v4 + 12, 1);                    // planes
+    put_le16(v4 + 14, 32);                   // bpp
+    put_le32(v4 + 16, 3);                    // BI_BITFIELDS
+    put_le32(v4 + 20, uint32_t(std::min<uint64_t>(dataSize, 0xFFFFFFFFu)));
+    put_le32(v4 + 24, 2835);                 // 72 dpi
+    put_le32(v4 + 28, 2835);
+    put_le32(v4 + 40, 0x00FF0000u);          // R mask
+    put_le32(v4 + 44, 0x0000FF00u);          // G mask
+    put_le32(v4 + 48, 0x000000FFu);          // B mask
+    put_le32(v4 + 52, 0xFF000000u);          // A mask
+    put_le32(v4 + 56, 0x73524742u);          // 'sRGB'
+
+    std::FILE* f = std::fopen(path.c_str(), "wb");
+    bool ok = f != nullptr;
+    if (ok) {
+        ok = std::fwrite(hdr, 1, hdrSize, f) == hdrSize
+          && std::fwrite(pixels, sizeof(uint32_t), size_t(w) * h, f) == size_t(w) * h;
+        ok = (std::fclose(f) == 0) && ok;
     }
-    if (stbi_write_bmp(path.c_str(), w, h, 4, buf.data())) {
+    if (ok) {
         std::cout << "Saved " << path << "\n";
     } else {
         std::cerr << "BMP save failed: " << path << "\n";
     }
 }
 
-void save_png_from_buffer(const uint32_t* pixels, int w, int h, const std::string& path) {
+// ---------------------------------------------------------------------------
+// QOI writer (qoiformat.org): single pass, no entropy coder, typically several
+// times faster than PNG at a somewhat larger size. Streams like PngWriter, and
+// rows are bottom-up in the file like the PNG/BMP paths.
+// ---------------------------------------------------------------------------
+
+QoiWriter::QoiWriter(const std::string& path, int w, int h)
+  : f(nullptr), width(w), height(h), good(true), pixelsDone(0), run(0),
+    prev(0xFF000000u), index{}
+{
+    out.reserve(1u << 20);
     ensure_parent(path);
-    std::vector<uint8_t> buf(w * h * 4);
-    for (int y = 0; y < h; ++y) {
-        std::memcpy(&buf[(h-1-y) * w * 4], &pixels[y * w], w * 4);
+    f = std::fopen(path.c_str(), "wb");
+    if (!f) { good = false; return; }
+
+    uint8_t hdr[14] = { 'q', 'o', 'i', 'f' };
+    hdr[4] = uint8_t(w >> 24); hdr[5] = uint8_t(w >> 16); hdr[6]  = uint8_t(w >> 8); hdr[7]  = uint8_t(w);
+    hdr[8] = uint8_t(h >> 24); hdr[9] = uint8_t(h >> 16); hdr[10] = uint8_t(h >> 8); hdr[11] = uint8_t(h);
+    hdr[12] = 4;   // RGBA
+    hdr[13] = 0;   // sRGB with linear alpha
+    good = std::fwrite(hdr, 1, 14, f) == 14;
+}
+
+QoiWriter::~QoiWriter() {
+    if (f) std::fclose(f);
+}
+
+void QoiWriter::flush_out() {
+    if (!out.empty()) {
+        good = good && std::fwrite(out.data(), 1, out.size(), f) == out.size();
+        out.clear();
+    }
+}
+
+bool QoiWriter::write_rows(const uint32_t* first, int count, long long rowStep) {
+    if (!good) return false;
+    for (int j = 0; j < count; ++j) {
+        const uint32_t* row = first + rowStep * j;
+        for (int x = 0; x < width; ++x) {
+            uint32_t px = row[x];
+            if (px == prev) {
+                if (++run == 62) { out.push_back(uint8_t(0xC0 | (run - 1))); run = 0; }
+                continue;
+            }
+            if (run > 0) { out.push_back(uint8_t(0xC0 | (run - 1))); run = 0; }
+
+            uint8_t r = uint8_t(px >> 16), g = uint8_t(px >> 8), b = uint8_t(px), a = uint8_t(px >> 24);
+            int h = (r * 3 + g * 5 + b * 7 + a * 11) & 63;
+            if (index[h] == px) {
+                out.push_back(uint8_t(h));                                   // QOI_OP_INDEX
+            } else {
+                index[h] = px;
+                if (a == uint8_t(prev >> 24)) {
+                    int8_t vr = int8_t(r - uint8_t(prev >> 16));
+                    int8_t vg = int8_t(g - uint8_t(prev >> 8));
+                    int8_t vb = int8_t(b - uint8_t(prev));
+                    int8_t vg_r = int8_t(vr - vg), vg_b = int8_t(vb - vg);
+                    if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                        out.push_back(uint8_t(0x40 | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2))); // QOI_OP_DIFF
+                    } else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8) {
+                        out.push_back(uint8_t(0x80 | (vg + 32)));             // QOI_OP_LUMA
+                        out.push_back(uint8_t((vg_r + 8) << 4 | (vg_b + 8)));
+                    } else {
+                        out.insert(out.end(), { 0xFE, r, g, b });            // QOI_OP_RGB
+                    }
+                } else {
+                    out.insert(out.end(), { 0xFF, r, g, b, a });             // QOI_OP_RGBA
+                }
+            }
+            prev = px;
+        }
+        if (out.size() >= (1u << 20)) flush_out();
+    }
+    pixelsDone += uint64_t(count) * width;
+    return good;
+}
+
+bool QoiWriter::finish() {
+    if (!f) return false;
+    if (pixelsDone != uint64_t(width) * height) good = false;
+    if (run > 0) { out.push_back(uint8_t(0xC0 | (run - 1))); run = 0; }
+    out.insert(out.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });                       // end marker
+    flush_out();
+    good = (std::fclose(f) == 0) && good;
+    f = nullptr;
+    return good;
+}
+
+void save_qoi_from_buffer(const uint32_t* pixels, int w, int h, const std::string& path) {
+    trace::Span span("image", "save_qoi");
+    QoiWriter qoi(path, w, h);
+    qoi.write_rows(pixels + size_t(h - 1) * w, h, -(long long)w);
+    if (qoi.finish()) {
+        std::cout << "Saved " << path << "\n";
+    } else {
+        std::cerr << "QOI save failed: " << path << "\n";
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Parallel PNG writer
+//
+// The image is cut into bands of rows. Every band is filtered and deflated on
+// its own thread into a non-final fixed-Huffman block followed by an empty
+// stored block (zlib "sync flush"), so the compressed bands end byte-aligned and
+// can simply be concatenated. Each band goes out as its own IDAT chunk (the
+// CRC is computed on the worker too); the per-band adler32s are combined at
+// the end and written as a last 4-byte IDAT.
+//
+// PngWriter takes rows in file order and only ever holds one batch of bands,
+// so it can also be fed band by band from a renderer (see export.cpp).
+// Pixels are converted from ARGB8888 to RGBA bytes, so colours match what's
+// on screen.
+// ---------------------------------------------------------------------------
+
+PngOptions& png_options() {
+    static PngOptions opt;
+    return opt;
+}
+
+namespace {
+
+struct BitWriter {
+    std::vector<uint8_t>& out;
+    uint32_t buf = 0;
+    int      cnt = 0;
+
+    explicit BitWriter(std::vector<uint8_t>& o) : out(o) {}
+
+    void put(uint32_t code, int bits) {
+        buf |= code << cnt;
+        cnt += bits;
+        while (cnt >= 8) {
+            out.push_back(uint8_t(buf));
+            buf >>= 8;
+            cnt -= 8;
+        }
+    }
+    void align() { if (cnt) put(0, 8 - cnt); }
+};
+
+inline int bitrev(int code, int bits) {
+    int r = 0;
+    while (bits--) { r = (r << 1) | (code & 1); code >>= 1; }
+    return r;
+}
+
+// fixed Huffman code for literal/length symbol n, already bit-reversed
+struct FixedHuff {
+    uint16_t code[288];
+    uint8_t  len[288];
+
+    FixedHuff() {
+        for (int n = 0; n < 288; ++n) {
+            int c, l;
+            if      (n <= 143) { c = 0x30  + n;       l = 8; }
+            else if (n <= 255) { c = 0x190 + n - 144; l = 9; }
+            else if (n <= 279) { c = n - 256;         l = 7; }
+            else               { c = 0xC0  + n - 280; l = 8; }
+            code[n] = uint16_t(bitrev(c, l));
+            len[n]  = uint8_t(l);
+        }
+    }
+};
+
+const FixedHuff& fixed_huff() {
+    static const FixedHuff H;
+    return H;
+}
+
+const uint16_t kLenBase[] = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258, 259 };
+const uint8_t  kLenExtra[]= { 0,0,0,0,0,0,0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4,  4,  5,  5,  5,  5,  0 };
+const uint16_t kDistBase[]= { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577, 32768 };
+const uint8_t  kDistExtra[]={ 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+
+const int kWindow   = 32768;
+const int kHashBits = 15;
+
+inline uint32_t hash3(const uint8_t* p) {
+    uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+    return (v * 2654435761u) >> (32 - kHashBits);
+}
+
+inline int match_len(const uint8_t* a, const uint8_t* b, size_t limit) {
+    int n = 0, lim = int(std::min<size_t>(limit, 258));
+    while (n < lim && a[n] == b[n]) ++n;
+    return n;
+}
+
+void put_stored(std::vector<uint8_t>& out, const uint8_t* d, size_t n, bool last) {
+    size_t i = 0;
+    do {
+        size_t blk = std::min<size_t>(n - i, 65535);
+        bool   fin = last && i + blk == n;
+        out.push_back(fin ? 1 : 0);                 // BFINAL, BTYPE = 0
+        out.push_back(uint8_t(blk));  out.push_back(uint8_t(blk >> 8));
+        out.push_back(uint8_t(~blk)); out.push_back(uint8_t(~blk >> 8));
+        out.insert(out.end(), d + i, d + i + blk);
+        i += blk;
+    } while (i < n);
+}
+
+// Raw deflate of one band: hash chains + one-step lazy matching, fixed Huffman
+// (same scheme as stbi_zlib_compress). Non-last bands end with a sync flush.
+void deflate_band(const uint8_t* d, size_t n, int level, bool last, std::vector<uint8_t>& out) {
+    size_t start = out.size();
+    if (level > 0) {
+        const FixedHuff& H = fixed_huff();
+        const int maxChain = level * 4;
+        std::vector<int32_t> head(size_t(1) << kHashBits, -1);
+        std::vector<int32_t> prev(kWindow, -1);
+
+        auto insert = [&](size_t p) {
+            uint32_t h = hash3(d + p);
+            prev[p & (kWindow - 1)] = head[h];
+            head[h] = int32_t(p);
+        };
+        auto longest = [&](size_t p, int& dist) {
+            int best = 2, chain = maxChain;
+            for (int32_t c = head[hash3(d + p)];
+                 c >= 0 && p - size_t(c) < size_t(kWindow) && chain-- > 0;
+                 c = prev[c & (kWindow - 1)]) {
+                int l = match_len(d + c, d + p, n - p);
+                if (l > best) { best = l; dist = int(p - c); if (l == 258) break; }
+            }
+            return best;
+        };
+
+        BitWriter bw(out);
+        bw.put(last ? 1 : 0, 1);   // BFINAL
+        bw.put(1, 2);              // BTYPE = 1 -- fixed huffman
+
+        size_t i = 0;
+        while (i + 3 <= n) {
+            int dist = 0;
+            int best = longest(i, dist);
+            insert(i);
+            if (best >= 3 && i + 4 <= n) {
+                int d2 = 0;
+                if (longest(i + 1, d2) > best) best = 0; // "lazy matching": next byte does better
+            }
+            if (best >= 3) {
+                int j = 0;
+                while (best > kLenBase[j + 1] - 1) ++j;
+                bw.put(H.code[257 + j], H.len[257 + j]);
+                if (kLenExtra[j]) bw.put(best - kLenBase[j], kLenExtra[j]);
+                j = 0;
+                while (dist > kDistBase[j + 1] - 1) ++j;
+                bw.put(bitrev(j, 5), 5);
+                if (kDistExtra[j]) bw.put(dist - kDistBase[j], kDistExtra[j]);
+                for (size_t k = i + 1; k < i + size_t(best) && k + 3 <= n; ++k) insert(k);
+                i += best;
+            } else {
+                bw.put(H.code[d[i]], H.len[d[i]]);
+                ++i;
+            }
+        }
+        for (; i < n; ++i) bw.put(H.code[d[i]], H.len[d[i]]);
+        bw.put(H.code[256], H.len[256]); // end of block
+
+        if (!last) {
+            bw.put(0, 3);                // empty stored block byte-aligns the band
+            bw.align();
+            out.push_back(0x00); out.push_back(0x00);
+            out.push_back(0xFF); out.push_back(0xFF);
+        } else {
+            bw.align();
+        }
+
+        // store uncompressed instead if compression was worse
+        if (out.size() - start <= n + 5 * (n / 65535 + 1)) return;
+        out.resize(start);
     }
-    if (stbi_write_png(path.c_str(), w, h, 4, buf.data(), w * 4)) {
+    put_stored(out, d, n, last);
+}
+
+uint32_t adler32(const uint8_t* d, size_t n) {
+    uint32_t s1 = 1, s2 = 0;
+    while (n) {
+        size_t blk = std::min<size_t>(n, 5552);
+        n -= blk;
+        while (blk--) { s1 += *d++; s2 += s1; }
+        s1 %= 65521; s2 %= 65521;
+    }
+    return (s2 << 16) | s1;
+}
+
+// adler32 of A+B from adler(A), adler(B) and len(B), as zlib's adler32_combine
+uint32_t adler32_combine(uint32_t a1, uint32_t a2, size_t len2) {
+    const uint32_t BASE = 65521;
+    uint32_t rem  = uint32_t(len2 % BASE);
+    uint32_t sum1 = a1 & 0xFFFF;
+    uint32_t sum2 = uint32_t((uint64_t(rem) * sum1) % BASE);
+    sum1 += (a2 & 0xFFFF) + BASE - 1;
+    sum2 += ((a1 >> 16) & 0xFFFF) + ((a2 >> 16) & 0xFFFF) + BASE - rem;
+    if (sum1 >= BASE) sum1 -= BASE;
+    if (sum1 >= BASE) sum1 -= BASE;
+    if (sum2 >= (BASE << 1)) sum2 -= (BASE << 1);
+    if (sum2 >= BASE) sum2 -= BASE;
+    return sum1 | (sum2 << 16);
+}
+
+uint32_t crc32(const uint8_t* d, size_t n) {
+    static const struct Table {
+        uint32_t t[256];
+        Table() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                t[i] = c;
+            }
+        }
+    } T;
+    uint32_t c = ~0u;
+    for (size_t i = 0; i < n; ++i) c = T.t[(c ^ d[i]) & 0xFF] ^ (c >> 8);
+    return ~c;
+}
+
+inline uint8_t paeth(int a, int b, int c) {
+    int p = a + b - c, pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return uint8_t(a);
+    if (pb <= pc) return uint8_t(b);
+    return uint8_t(c);
+}
+
+// ARGB8888 -> RGBA bytes
+void to_rgba(const uint32_t* src, int w, uint8_t* dst) {
+    for (int x = 0; x < w; ++x) {
+        uint32_t p = src[x];
+        dst[4*x + 0] = uint8_t(p >> 16);
+        dst[4*x + 1] = uint8_t(p >> 8);
+        dst[4*x + 2] = uint8_t(p);
+        dst[4*x + 3] = uint8_t(p >> 24);
+    }
+}
+
+void filter_row(const uint8_t* cur, const uint8_t* up, int n, int type, uint8_t* dst) {
+    const int bpp = 4;
+    for (int i = 0; i < n; ++i) {
+        int a = i >= bpp ? cur[i - bpp] : 0;
+        int b = up[i];
+        int c = i >= bpp ? up[i - bpp] : 0;
+        switch (type) {
+            case 0: dst[i] = cur[i]; break;
+            case 1: dst[i] = uint8_t(cur[i] - a); break;
+            case 2: dst[i] = uint8_t(cur[i] - b); break;
+            case 3: dst[i] = uint8_t(cur[i] - ((a + b) >> 1)); break;
+            case 4: dst[i] = uint8_t(cur[i] - paeth(a, b, c)); break;
+        }
+    }
+}
+
+// Filter byte + filtered row into dst (n+1 bytes). up is all zeros for the first row.
+void encode_row(const uint8_t* cur, const uint8_t* up, int n, int forced, uint8_t* dst) {
+    if (forced >= 0 && forced <= 4) {
+        dst[0] = uint8_t(forced);
+        filter_row(cur, up, n, forced, dst + 1);
+        return;
+    }
+    // Estimate the best filter by running through all of them; the smaller the sum, the better
+    int  bestType = 0;
+    long bestVal  = -1;
+    for (int t = 0; t < 5; ++t) {
+        filter_row(cur, up, n, t, dst + 1);
+        long est = 0;
+        for (int i = 0; i < n; ++i) est += std::abs(int(int8_t(dst[1 + i])));
+        if (bestVal < 0 || est < bestVal) { bestVal = est; bestType = t; }
+    }
+    if (bestType != 4) filter_row(cur, up, n, bestType, dst + 1);
+    dst[0] = uint8_t(bestType);
+}
+
+struct PngBand {
+    const uint32_t* first = nullptr; // first pixel row of the band
+    int  row   = 0;                  // its file row
+    int  rows  = 0;
+    bool last  = false;              // final band of the image -> BFINAL
+    std::vector<uint8_t> chunk;      // "IDAT" + deflate bytes
+    uint32_t crc   = 0;
+    uint32_t adler = 1;
+    size_t   raw   = 0;              // filtered (uncompressed) length
+};
+
+void put_be32(std::vector<uint8_t>& v, uint32_t x) {
+    v.push_back(uint8_t(x >> 24)); v.push_back(uint8_t(x >> 16));
+    v.push_back(uint8_t(x >> 8));  v.push_back(uint8_t(x));
+}
+
+// tagAndData = 4-byte chunk type followed by len bytes of payload
+bool write_chunk(std::FILE* f, const uint8_t* tagAndData, size_t len, uint32_t crc) {
+    uint8_t hdr[4]  = { uint8_t(len >> 24), uint8_t(len >> 16), uint8_t(len >> 8), uint8_t(len) };
+    uint8_t tail[4] = { uint8_t(crc >> 24), uint8_t(crc >> 16), uint8_t(crc >> 8), uint8_t(crc) };
+    return std::fwrite(hdr, 1, 4, f) == 4
+        && std::fwrite(tagAndData, 1, len + 4, f) == len + 4
+        && std::fwrite(tail, 1, 4, f) == 4;
+}
+
+bool write_chunk(std::FILE* f, const std::vector<uint8_t>& tagAndData) {
+    return write_chunk(f, tagAndData.data(), tagAndData.size() - 4,
+                       crc32(tagAndData.data(), tagAndData.size()));
+}
+
+} // namespace
+
+PngWriter::PngWriter(const std::string& path, int w, int h, const PngOptions& opt)
+  : f(nullptr), width(w), height(h), opt(opt), good(true), rowsDone(0), adler(1),
+    prevRow(size_t(w) * 4, 0)
+{
+    nThreads = opt.threads > 0 ? opt.threads : int(std::thread::hardware_concurrency());
+    if (nThreads <= 0) nThreads = 4;
+
+    // A few bands per thread keeps every core busy; very short bands hurt the
+    // ratio and very long ones cost memory (a band is held filtered + compressed).
+    const size_t rowBytes = size_t(w) * 4 + 1;
+    bandRows = opt.bandRows;
+    if (bandRows <= 0) {
+        int minRows = int(std::min<size_t>(h, (256 * 1024) / rowBytes + 1));
+        int maxRows = std::max(minRows, int((8u << 20) / rowBytes));
+        bandRows = std::clamp((h + nThreads * 4 - 1) / (nThreads * 4), minRows, maxRows);
+    }
+
+    ensure_parent(path);
+    f = std::fopen(path.c_str(), "wb");
+    if (!f) { good = false; return; }
+
+    static const uint8_t sig[8] = { 137,80,78,71,13,10,26,10 };
+    good = std::fwrite(sig, 1, 8, f) == 8;
+
+    std::vector<uint8_t> ihdr = { 'I', 'H', 'D', 'R' };
+    put_be32(ihdr, uint32_t(w));
+    put_be32(ihdr, uint32_t(h));
+    ihdr.insert(ihdr.end(), { 8, 6, 0, 0, 0 }); // 8-bit RGBA, deflate, adaptive filter, no interlace
+    good = good && write_chunk(f, ihdr);
+}
+
+PngWriter::~PngWriter() {
+    if (f) std::fclose(f);
+}
+
+bool PngWriter::write_rows(const uint32_t* first, int count, long long rowStep) {
+    const int rowBytes = width * 4;
+
+    while (good && count > 0 && rowsDone < height) {
+        // one batch = a couple of bands per thread, compressed in parallel then written in order
+        std::vector<PngBand> bands;
+        int batch = 0;
+        while (batch < count && int(bands.size()) < nThreads * 2 && rowsDone + batch < height) {
+            PngBand b;
+            b.first = first + rowStep * batch;
+            b.row   = rowsDone + batch;
+            b.rows  = std::min({ bandRows, count - batch, height - rowsDone - batch });
+            b.last  = rowsDone + batch + b.rows == height;
+            batch  += b.rows;
+            bands.push_back(std::move(b));
+        }
+
+        std::atomic<int> next{0};
+        auto worker = [&]() {
+            std::vector<uint8_t> cur(rowBytes), up(rowBytes), filt;
+            for (int bi = next++; bi < int(bands.size()); bi = next++) {
+                PngBand& b = bands[bi];
+                trace::Span span("image", "png_band", b.row, b.row + b.rows);
+                b.raw = size_t(b.rows) * (rowBytes + 1);
+                filt.resize(b.raw);
+
+                if (bi == 0) std::copy(prevRow.begin(), prevRow.end(), up.begin());
+                else         to_rgba(b.first - rowStep, width, up.data());
+                for (int j = 0; j < b.rows; ++j) {
+                    to_rgba(b.first + rowStep * j, width, cur.data());
+                    encode_row(cur.data(), up.data(), rowBytes, opt.filter,
+                               &filt[size_t(j) * (rowBytes + 1)]);
+                    std::swap(cur, up);
+                }
+
+                b.adler = adler32(filt.data(), filt.size());
+                b.chunk.assign({ 'I', 'D', 'A', 'T' });
+                if (bi == 0 && rowsDone == 0) { b.chunk.push_back(0x78); b.chunk.push_back(0x5e); } // zlib header
+                deflate_band(filt.data(), filt.size(), opt.level, b.last, b.chunk);
+                b.crc = crc32(b.chunk.data(), b.chunk.size());
+            }
+        };
+
+        int nWorkers = std::min(nThreads, int(bands.size()));
+        if (nWorkers <= 1) {
+            worker();
+        } else {
+            std::vector<std::thread> pool;
+            pool.reserve(nWorkers);
+            for (int i = 0; i < nWorkers; ++i) pool.emplace_back(worker);
+            for (auto& th : pool) th.join();
+        }
+
+        trace::Span span("image", "png_write", rowsDone, rowsDone + batch);
+        for (const PngBand& b : bands) {
+            good = good && write_chunk(f, b.chunk.data(), b.chunk.size() - 4, b.crc);
+            adler = adler32_combine(adler, b.adler, b.raw);
+        }
+        to_rgba(first + rowStep * (batch - 1), width, prevRow.data());
+        rowsDone += batch;
+        first    += rowStep * batch;
+        count    -= batch;
+    }
+    return good;
+}
+
+bool PngWriter::finish() {
+    if (!f) return false;
+    if (rowsDone != height) good = false;
+
+    std::vector<uint8_t> tail = { 'I', 'D', 'A', 'T' };
+    put_be32(tail, adler);
+    good = good && write_chunk(f, tail);
+
+    std::vector<uint8_t> iend = { 'I', 'E', 'N', 'D' };
+    good = good && write_chunk(f, iend);
+    good = (std::fclose(f) == 0) && good;
+    f = nullptr;
+    return good;
+}
+
+void save_png_from_buffer(const uint32_t* pixels, int w, int h, const std::string& path) {
+    save_png_from_buffer(pixels, w, h, path, png_options());
+}
+
+void save_png_from_buffer(const uint32_t* pixels, int w, int h, const std::string& path,
+                          const PngOptions& opt) {
+    trace::Span span("image", "save_png");
+    // file row j holds pixel row h-1-j (same flip as the BMP path)
+    PngWriter png(path, w, h, opt);
+    png.write_rows(pixels + size_t(h - 1) * w, h, -(long long)w);
+    if (png.finish()) {
         std::cout << "Saved " << path << "\n";
     } else {
         std::cerr << "PNG save failed: " << path << "\n";
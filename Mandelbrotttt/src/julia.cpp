@@ -1,5 +1,12 @@
 #include "julia.h"
-#include <SDL3/SDL.h>
+#include "metrics.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <iostream>
+#include <thread>
 
 Julia::Julia(int w, int h)
   : width(w), height(h),
@@ -16,36 +23,215 @@ void Julia::updateFactors() {
     imFactor = (maxIm - minIm) / double(height - 1);
 }
 
-uint32_t Julia::mapColor(int iter, int maxIter) {
-    if (iter == maxIter) return 0xFF000000u;
-    uint8_t r = (iter * 9) % 256;
-    uint8_t g = (iter * 7) % 256;
-    uint8_t b = (iter * 5) % 256;
-    return (0xFFu << 24) | (r << 16) | (g << 8) | b;
+bool Julia::centred() const {
+    const double eps = 1e-12;
+    return std::abs(minRe + maxRe) <= eps * (maxRe - minRe) &&
+           std::abs(minIm + maxIm) <= eps * (maxIm - minIm);
 }
 
-void Julia::render(SDL_Renderer* rend, SDL_Texture* tex) {
-    const int maxIter = 500;
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            double zr = minRe + x * reFactor;
-            double zi = maxIm - y * imFactor;
-            int n = 0;
-            while (n < maxIter && zr*zr + zi*zi <= 4.0) {
-                double tmp = zr*zr - zi*zi + c_re;
-                zi = 2.0 * zr * zi + c_im;
-                zr = tmp;
-                ++n;
+escape::View Julia::view() const {
+    escape::View v;
+    v.minRe = minRe; v.maxRe = maxRe;
+    v.minIm = minIm; v.maxIm = maxIm;
+    v.width = width; v.height = height;
+    v.maxIter = maxIter;
+    v.cRe = c_re; v.cIm = c_im;
+    // pixel (w-1-x, h-1-y) at exactly -z of pixel (x, y), so the rotated half
+    // render_symmetric copies is bit-identical to a computed one
+    if (centred()) { v.mirrorSum = height - 1; v.mirrorCols = width - 1; }
+    return v;
+}
+
+template <class Color>
+bool Julia::render_symmetric(typename Color::Out* dst, int threadCount) const {
+    trace::Span span("julia", "compute");
+    const escape::View v = view();
+    const int w = width, h = height;
+    bool mirrored = false;
+    escape::dispatch(formula, precision, true, [&](auto k) {
+        using K = decltype(k);
+        using F = typename K::formula;
+        using Out = typename Color::Out;
+        // 180-degree symmetry: compute the top half (plus the middle row), then
+        // the bottom half is the top half rotated
+        int top = h;
+        if (escape::point_symmetric<F> && centred()) { top = (h + 1) / 2; mirrored = true; }
+
+        escape::split_rows(0, top, threadCount, [=](int a, int b) {
+            escape::render_rows<F, typename K::real, Color>(dst + size_t(a) * w, v, a, b);
+        });
+        if (top < h) {
+            escape::split_rows(top, h, threadCount, [=](int a, int b) {
+                for (int y = a; y < b; ++y) {
+                    const Out* src = dst + size_t(h - 1 - y) * w;
+                    std::reverse_copy(src, src + w, dst + size_t(y) * w);
+                }
+            });
+        }
+    });
+    return mirrored;
+}
+
+bool Julia::compute(int threadCount) {
+    return render_symmetric<escape::Bands>(pixels.data(), threadCount);
+}
+
+bool Julia::compute_field(uint32_t* iters, int threadCount) const {
+    return render_symmetric<escape::Iterations>(iters, threadCount);
+}
+
+void Julia::compute_only(int threadCount) {
+    int nThreads = threadCount > 0 ? threadCount : int(std::thread::hardware_concurrency());
+    if (nThreads <= 0) nThreads = 4;
+
+    metrics::FrameScope frame("julia", nThreads);
+    bool mirrored = compute(nThreads);
+    // mirrored: the rows below the middle one are the top half rotated
+    uint64_t copied = mirrored ? uint64_t(height - (height + 1) / 2) * width : 0;
+    frame.finish(uint64_t(width) * height - copied, copied, pixels.capacity() * sizeof(uint32_t));
+}
+
+bool Julia::compute_preview(uint32_t* dst, int w, int h, int threadCount,
+                            const std::atomic<bool>* cancel) const {
+    trace::Span span("julia", "preview", 0, h);
+    escape::View v;
+    v.minRe = minRe; v.maxRe = maxRe;
+    v.minIm = minIm; v.maxIm = maxIm;
+    v.width = w; v.height = h;
+    v.maxIter = maxIter;
+    v.cRe = c_re; v.cIm = c_im;
+
+    escape::dispatch(formula, precision, true, [&](auto k) {
+        using K = decltype(k);
+        escape::split_rows(0, h, threadCount, [=](int a, int b) {
+            for (int y = a; y < b; ++y) {
+                if (cancel && cancel->load(std::memory_order_relaxed)) return;
+                escape::render_rows<typename K::formula, typename K::real, escape::Bands>(
+                    dst + size_t(y) * w, v, y, y + 1);
             }
-            pixels[y * width + x] = mapColor(n, maxIter);
+        });
+    });
+    return !(cancel && cancel->load());
+}
+
+bool Julia::compute_boundary(int hitLimit, int threadCount) {
+    if (formula != escape::Formula::Mandelbrot) return false;
+    trace::Span span("julia", "boundary");
+    int nThreads = threadCount > 0 ? threadCount : int(std::thread::hardware_concurrency());
+    if (nThreads <= 0) nThreads = 4;
+    hitLimit = std::max(1, std::min(255, hitLimit));
+
+    metrics::FrameScope frame("julia-boundary", nThreads);
+
+    using cplx = std::complex<double>;
+    const cplx c(c_re, c_im);
+    const double rF = reFactor, iF = imFactor;
+    const double x0 = minRe, y0 = maxIm;
+    const int w = width, h = height;
+
+    // Branches that leave the view still have to be followed (their preimages can come
+    // back), so they are counted on a coarse grid over the disc that holds the set.
+    const int    G = 512;
+    const double R = std::max(2.0, std::abs(c));
+    const double gF = (2.0 * R) / G;
+
+    // One hit grid (the view's pixels, then the coarse cells), one byte per cell.
+    const size_t viewCells = size_t(w) * h;
+    std::vector<uint8_t> hits(viewCells + size_t(G) * G, 0);
+    auto cell_of = [&](const cplx& z) {
+        int px = int(std::floor((z.real() - x0) / rF + 0.5));
+        int py = int(std::floor((y0 - z.imag()) / iF + 0.5));
+        if (px >= 0 && px < w && py >= 0 && py < h) return uint32_t(size_t(py) * w + px);
+        int gx = std::clamp(int((z.real() + R) / gF), 0, G - 1);
+        int gy = std::clamp(int((z.imag() + R) / gF), 0, G - 1);
+        return uint32_t(viewCells + size_t(gy) * G + gx);
+    };
+
+    // Root: beta = 1/2 + sqrt(1/4 - c) is a repelling fixed point, always in the set.
+    // Walk the tree one level at a time: the level's visits are claimed against the
+    // grid in order on this thread, then the threads take the square roots (and the
+    // cells) of the next level, so the walk and the image are the same for any thread
+    // count. Narrow levels aren't worth starting threads for.
+    const int parallelMin = 4096;
+    std::vector<cplx> level{ 0.5 + std::sqrt(0.25 - c) }, next;
+    std::vector<uint32_t> cells{ cell_of(level[0]) }, nextCells;
+    std::vector<uint32_t> kept;
+    size_t points = 0;
+    while (!level.empty()) {
+        points += level.size();
+        kept.clear();
+        for (size_t k = 0; k < level.size(); ++k) {
+            uint8_t& hit = hits[cells[k]];
+            if (hit < hitLimit) { ++hit; kept.push_back(uint32_t(k)); }
         }
+
+        next.resize(kept.size() * 2);
+        nextCells.resize(kept.size() * 2);
+        auto expand = [&](int a, int b) {
+            for (int j = a; j < b; ++j) {
+                cplx s = std::sqrt(level[kept[j]] - c);
+                next[2 * j]     = s;
+                next[2 * j + 1] = -s;
+                nextCells[2 * j]     = cell_of(s);
+                nextCells[2 * j + 1] = cell_of(-s);
+            }
+        };
+        if (nThreads > 1 && int(kept.size()) >= parallelMin)
+            escape::split_rows(0, int(kept.size()), nThreads, expand);
+        else
+            expand(0, int(kept.size()));
+        level.swap(next);
+        cells.swap(nextCells);
+    }
+
+    // darkness by how often the pixel was hit, up to hitLimit
+    for (size_t i = 0; i < viewCells; ++i) {
+        uint8_t s = uint8_t(255 - 255 * hits[i] / hitLimit);
+        pixels[i] = 0xFF000000u | (s << 16) | (s << 8) | s;
     }
-    SDL_UpdateTexture(tex, nullptr, pixels.data(), width * sizeof(uint32_t));
-    SDL_SetRenderDrawBlendMode(rend, SDL_BLENDMODE_NONE);
-    SDL_SetRenderDrawColor(rend, 0,0,0,255);
-    SDL_RenderClear(rend);
-    SDL_RenderTexture(rend, tex, nullptr, nullptr);
-    SDL_RenderPresent(rend);
+
+    // points visited stand in for iterations; buffers: pixels, hit grid and the two levels
+    frame.finish(uint64_t(w) * h, 0,
+                 pixels.capacity() * sizeof(uint32_t) + hits.size() +
+                 (level.capacity() + next.capacity()) * sizeof(cplx) +
+                 (cells.capacity() + nextCells.capacity() + kept.capacity()) * sizeof(uint32_t),
+                 points);
+    return true;
+}
+
+bool Julia::compute_distance(int threadCount) {
+    trace::Span span("julia", "distance");
+    int nThreads = threadCount > 0 ? threadCount : int(std::thread::hardware_concurrency());
+    if (nThreads <= 0) nThreads = 4;
+
+    metrics::FrameScope frame("julia-distance", nThreads);
+    const escape::View v = view();
+
+    std::vector<float> de(pixels.size());
+    bool ok = false;
+    escape::dispatch(formula, precision, true, [&](auto k) {
+        using K = decltype(k);
+        using F = typename K::formula;
+        if constexpr (F::analytic) {
+            float* d = de.data();
+            const int w = width;
+            escape::split_rows(0, height, nThreads, [=](int a, int b) {
+                escape::distance_rows<F, typename K::real>(nullptr, d + size_t(a) * w, v, a, b);
+            });
+            ok = true;
+        }
+    });
+    if (!ok) return false;
+    for (size_t i = 0; i < de.size(); ++i) pixels[i] = escape::line_value(de[i], reFactor);
+
+    frame.finish(de.size(), 0, pixels.capacity() * sizeof(uint32_t) + de.capacity() * sizeof(float));
+    return true;
+}
+
+void Julia::update(int threadCount) {
+    bool done = (distance && compute_distance(threadCount)) ||
+                (boundary && compute_boundary(boundaryHits, threadCount));
+    if (!done) compute_only(threadCount);
 }
 
 void Julia::setConstant(double cre, double cim) {
@@ -0,0 +1,106 @@
+#include "latency.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+
+LatencyHistogram::LatencyHistogram()
+  : counts(size_t(sub) + size_t(64 - subBits) * (sub / 2), 0) {}
+
+// below sub: the value itself. Above: its top subBits bits (in [sub/2, sub)) pick
+// one of sub/2 buckets inside its power of two
+int LatencyHistogram::index(uint64_t v) {
+    if (v < uint64_t(sub)) return int(v);
+    int m = 63;
+    while (!(v >> m)) --m;                 // highest set bit, >= subBits
+    int shift = m - (subBits - 1);
+    int top   = int(v >> shift);           // [sub/2, sub)
+    return sub + (m - subBits) * (sub / 2) + (top - sub / 2);
+}
+
+uint64_t LatencyHistogram::upper(int i) {
+    if (i < sub) return uint64_t(i);
+    int k = i - sub;
+    int m = subBits + k / (sub / 2);
+    uint64_t top = uint64_t(sub / 2 + k % (sub / 2));
+    int shift = m - (subBits - 1);
+    return ((top + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t v) {
+    ++counts[size_t(index(v))];
+    ++n;
+    sum += v;
+    hi = std::max(hi, v);
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    if (n == 0) return 0;
+    uint64_t want = uint64_t(std::ceil(std::clamp(p, 0.0, 100.0) / 100.0 * double(n)));
+    want = std::max<uint64_t>(want, 1);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= want) return std::min(upper(int(i)), hi);
+    }
+    return hi;
+}
+
+std::vector<std::pair<uint64_t, uint64_t>> LatencyHistogram::buckets() const {
+    std::vector<std::pair<uint64_t, uint64_t>> out;
+    for (size_t i = 0; i < counts.size(); ++i)
+        if (counts[i]) out.push_back({ upper(int(i)), counts[i] });
+    return out;
+}
+
+void LatencyStats::record(uint64_t input, uint64_t ready, uint64_t uploaded, uint64_t presented) {
+    // microseconds; an event stamped after ready (clock skew) counts as 0
+    auto us = [](uint64_t a, uint64_t b) { return b > a ? (b - a) / 1000 : 0; };
+    total.record(us(input, presented));
+    compute.record(us(input, ready));
+    upload.record(us(ready, uploaded));
+    present.record(us(uploaded, presented));
+}
+
+void LatencyStats::print() const {
+    if (total.count() == 0) return;
+    std::printf("Input latency, %llu frames (ms):\n", (unsigned long long)total.count());
+    const struct { const char* name; const LatencyHistogram& h; } rows[] = {
+        { "total", total }, { "compute", compute }, { "upload", upload }, { "present", present },
+    };
+    for (const auto& r : rows)
+        std::printf("  %-8s p50 %8.2f  p99 %8.2f  max %8.2f\n", r.name,
+                    r.h.percentile(50) / 1e3, r.h.percentile(99) / 1e3, r.h.max() / 1e3);
+}
+
+bool LatencyStats::write(const std::string& path) const {
+    try {
+        std::filesystem::path p(path);
+        if (p.has_parent_path()) std::filesystem::create_directories(p.parent_path());
+    } catch (...) {}
+    std::FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) {
+        std::cerr << "Cannot write latency file " << path << "\n";
+        return false;
+    }
+    std::fprintf(f, "{\n  \"frames\": %llu,\n", (unsigned long long)total.count());
+    const struct { const char* name; const LatencyHistogram& h; } rows[] = {
+        { "total", total }, { "compute", compute }, { "upload", upload }, { "present", present },
+    };
+    for (const auto& r : rows)
+        std::fprintf(f, "  \"%s\": {\"p50_ms\": %.3f, \"p90_ms\": %.3f, \"p99_ms\": %.3f, "
+                        "\"max_ms\": %.3f, \"mean_ms\": %.3f},\n", r.name,
+                     r.h.percentile(50) / 1e3, r.h.percentile(90) / 1e3, r.h.percentile(99) / 1e3,
+                     r.h.max() / 1e3, r.h.mean() / 1e3);
+    // [upper edge ms, count] per non-empty bucket of the total
+    std::fputs("  \"total_buckets\": [", f);
+    auto b = total.buckets();
+    for (size_t i = 0; i < b.size(); ++i)
+        std::fprintf(f, "%s[%.3f, %llu]", i ? ", " : "", b[i].first / 1e3, (unsigned long long)b[i].second);
+    std::fputs("]\n}\n", f);
+    bool ok = std::fclose(f) == 0;
+    if (ok) std::cout << "Wrote latency histogram to " << path << "\n";
+    return ok;
+}
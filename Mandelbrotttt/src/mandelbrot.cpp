@@ -1,79 +1,368 @@
 #include "mandelbrot.h"
+#include "metrics.h"
+#include "trace.h"
 #include <thread>
 #include <chrono>
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <cstring>
+#include <type_traits>
 
-Fractal::Fractal(int w, int h)
+Fractal::Fractal(int w, int h, bool allocate)
  : width(w), height(h),
-   minRe(-2.0), maxRe(1.0),
-   pixels(w*h, 0xFF000000u)
+   minRe(-2.0), maxRe(1.0), minIm(0.0), maxIm(0.0),
+   pixels(allocate ? size_t(w) * h : 0, 0xFF000000u)
 {
     update_factors();
 }
 
 void Fractal::reset() {
-    minRe = -2.0; maxRe = 1.0;
+    setView(-0.5, 0.0, 3.0);
+}
+
+void Fractal::setView(double cre, double cim, double spanRe) {
+    minRe = cre - spanRe / 2; maxRe = cre + spanRe / 2;
+    minIm = maxIm = cim;
     update_factors();
 }
 
 void Fractal::update_factors() {
-    minIm    = -(maxRe - minRe) * height / double(width) / 2.0;
-    maxIm    = -minIm;
+    orbitsValid = false;
+    // height follows the aspect ratio around the current imaginary centre
+    double cIm  = (minIm + maxIm) / 2.0;
+    double half = (maxRe - minRe) * height / double(width) / 2.0;
+    minIm    = cIm - half;
+    maxIm    = cIm + half;
     reFactor = (maxRe - minRe) / double(width - 1);
     imFactor = (maxIm - minIm) / double(height - 1);
 }
 
-void Fractal::clear_and_present(SDL_Renderer* r, SDL_Texture* t) {
-    SDL_SetRenderDrawBlendMode(r, SDL_BLENDMODE_NONE);
-    SDL_SetRenderDrawColor(r, 0,0,0,255);
-    SDL_RenderClear(r);
-    SDL_RenderTexture(r, t, nullptr, nullptr);
-    SDL_RenderPresent(r);
+void Fractal::compute(int threadCount) {
+    trace::Span span("fractal", "compute");
+    if (keepOrbits) compute_orbits(threadCount);
+    else            compute_rows(pixels.data(), 0, height, threadCount);
 }
 
-void Fractal::render_cpu(SDL_Renderer* r, SDL_Texture* t, int threadCount) {
-    // compute
-    compute_only(threadCount);
-    // present
-    SDL_UpdateTexture(t, nullptr, pixels.data(), width * sizeof(uint32_t));
-    clear_and_present(r, t);
+void Fractal::compute_only(int threadCount) {
+    int nThreads = threadCount > 0 ? threadCount : int(std::thread::hardware_concurrency());
+    if (nThreads <= 0) nThreads = 4;
+
+    metrics::FrameScope frame("mandelbrot", nThreads);
+    compute(nThreads);
+    uint64_t copied = uint64_t(mirrored_rows()) * width;
+    frame.finish(uint64_t(width) * height - copied, copied, buffer_bytes());
 }
 
-void Fractal::render_gpu(SDL_Renderer* r, SDL_Texture* t) {
-    // I don't have GPU, so.... no.... wkwk (kalau ada waktu atau apalah)
-    render_cpu(r, t);
+void Fractal::compute_orbits(int threadCount) {
+    orbits.resize(size_t(width) * height);
+    run_kernel<escape::Orbit>(orbits.data(), 0, height, threadCount);
+
+    // rows run_kernel copied across the real axis hold their partner's orbit; theirs is its conjugate
+    bool mirrors = false;
+    escape::dispatch(formula, precision, false, [&](auto k) {
+        mirrors = escape::real_symmetric<typename decltype(k)::formula>;
+    });
+    int m0, m1, S;
+    if (mirrors && mirror_range(0, height, m0, m1, S))
+        for (size_t i = size_t(m0) * width; i < size_t(m1) * width; ++i) orbits[i].zi = -orbits[i].zi;
+
+    colour_from_orbits();
+    orbitsValid = true;
 }
 
-void Fractal::compute_only(int threadCount) {
-    int nThreads = threadCount > 0 ? threadCount : int(std::thread::hardware_concurrency());
-    if (nThreads <= 0) nThreads = 4;
+void Fractal::colour_from_orbits() {
+    trace::Span span("fractal", "colour");
+    for (size_t i = 0; i < orbits.size(); ++i)
+        pixels[i] = escape::Gray::value(int(orbits[i].n), maxIter);
+}
+
+bool Fractal::raise_max_iter(int newMax, int threadCount) {
+    if (!keepOrbits || !orbitsValid || newMax < maxIter) {
+        setMaxIter(newMax);
+        compute_only(threadCount);
+        return false;
+    }
+
+    trace::Span span("fractal", "raise_max_iter");
+    metrics::FrameScope frame("resume", threadCount > 0 ? threadCount
+                                                        : int(std::thread::hardware_concurrency()));
+    const uint32_t oldMax = uint32_t(maxIter);
+    maxIter = newMax;
+    std::atomic<size_t> resumed{0};
+    std::atomic<uint64_t> steps{0};
+    const escape::View v = view();
+
+    escape::dispatch(formula, precision, false, [&](auto k) {
+        using K    = decltype(k);
+        using F    = typename K::formula;
+        using Real = typename K::real;
+
+        // mirrored rows are copied again, as compute_orbits left them
+        int m0 = height, m1 = height, S = 0;
+        if (escape::real_symmetric<F>) mirror_range(0, height, m0, m1, S);
 
-    int rowsPer  = std::max(1, height / nThreads);
-
-    auto t0 = std::chrono::high_resolution_clock::now();
-
-    if (nThreads == 1) {
-        render_section(pixels.data(), width, height,
-                       minRe, maxRe, minIm, maxIm, 0, height);
-    } else {
-        std::vector<std::thread> pool;
-        pool.reserve(nThreads);
-        for (int i = 0; i < nThreads; ++i) {
-            int y0 = i * rowsPer;
-            int y1 = (i + 1 == nThreads ? height : y0 + rowsPer);
-            pool.emplace_back([=]() {
-                render_section(const_cast<uint32_t*>(pixels.data()), width, height,
-                               minRe, maxRe, minIm, maxIm, y0, y1);
+        auto resume = [&](int r0, int r1) {
+            if (r0 >= r1) return;
+            escape::split_rows(r0, r1, threadCount, [&](int a, int b) {
+                size_t count = 0;
+                uint64_t n = 0;
+                for (int y = a; y < b; ++y) {
+                    double ci = escape::row_im(v, imFactor, y);
+                    escape::OrbitPoint* row = &orbits[size_t(y) * width];
+                    for (int x = 0; x < width; ++x) {
+                        escape::OrbitPoint& o = row[x];
+                        if (o.n != oldMax) continue;
+                        double cr = minRe + x * reFactor;
+                        // known never to escape: only the count moves (z isn't needed again)
+                        if (std::is_same_v<F, escape::Mandelbrot> && escape::in_main_bulbs(cr, ci)) {
+                            o.n = uint32_t(newMax);
+                            continue;
+                        }
+                        Real zr = Real(o.zr), zi = Real(o.zi);
+                        int more = escape::iterate<F>(zr, zi, Real(cr), Real(ci), newMax - int(oldMax));
+                        o.n += uint32_t(more);
+                        o.zr = double(zr); o.zi = double(zi);
+                        n += uint64_t(more);
+                        ++count;
+                    }
+                }
+                resumed += count;
+                steps   += n;
             });
+        };
+        resume(0, m0);
+        resume(m1, height);
+        for (int y = m0; y < m1; ++y) {
+            const escape::OrbitPoint* src = &orbits[size_t(S - y) * width];
+            escape::OrbitPoint* dst = &orbits[size_t(y) * width];
+            for (int x = 0; x < width; ++x) dst[x] = { src[x].zr, -src[x].zi, src[x].n };
         }
-        for (auto &th : pool) th.join();
-    }
+    });
+    colour_from_orbits();
+
+    // continued pixels are the computed ones, the rest kept their count
+    frame.finish(resumed.load(), orbits.size() - resumed.load(), buffer_bytes(), steps.load());
+    return true;
+}
+
+bool Fractal::orbit_counts(uint32_t* iters) const {
+    if (!orbitsValid) return false;
+    for (size_t i = 0; i < orbits.size(); ++i) iters[i] = orbits[i].n;
+    return true;
+}
+
+int Fractal::mirrored_rows() const {
+    bool mirrors = false;
+    escape::dispatch(formula, precision, false, [&](auto k) {
+        mirrors = escape::real_symmetric<typename decltype(k)::formula>;
+    });
+    int m0, m1, S;
+    return mirrors && mirror_range(0, height, m0, m1, S) ? m1 - m0 : 0;
+}
+
+size_t Fractal::buffer_bytes() const {
+    return pixels.capacity() * sizeof(uint32_t) + orbits.capacity() * sizeof(escape::OrbitPoint);
+}
+
+escape::View Fractal::view() const {
+    escape::View v;
+    v.minRe = minRe; v.maxRe = maxRe;
+    v.minIm = minIm; v.maxIm = maxIm;
+    v.width = width; v.height = height;
+    v.maxIter = maxIter;
+    int S;
+    if (mirror_row_sum(S)) v.mirrorSum = S;
+    return v;
+}
+
+bool Fractal::mirror_row_sum(int& S) const {
+    double s = (height - 1) + (maxIm + minIm) / imFactor;
+    if (!(std::abs(s) < 1e9)) return false;
+    S = int(std::lround(s));
+    return std::abs(s - S) < 1e-6;
+}
+
+bool Fractal::mirror_range(int y0, int y1, int& m0, int& m1, int& S) const {
+    // Real-axis symmetry: rows y and S - y are conjugates, so rows below the axis
+    // whose partner is in [y0, y1) can be copied instead of iterated ([m0, m1)).
+    m0 = m1 = y1;
+    if (!mirror_row_sum(S)) return false;
+    m0 = std::max(y0, S / 2 + 1);
+    m1 = std::min(y1, S - y0 + 1);
+    if (m0 >= m1) { m0 = m1 = y1; return false; }
+    return true;
+}
+
+template <class Color>
+void Fractal::run_kernel(typename Color::Out* dst, int y0, int y1, int threadCount,
+                         double jx, double jy) const {
+    trace::Span span("fractal", "rows", y0, y1);
+    const escape::View v = view();
+    escape::dispatch(formula, precision, false, [&](auto k) {
+        using K = decltype(k);
+        using F = typename K::formula;
+        using Out = typename Color::Out;
 
-    auto t1 = std::chrono::high_resolution_clock::now();
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
-    std::cout << (nThreads == 1 ? "[single]" : "[multi]") << " compute "
-              << ms << " ms (" << nThreads << " threads)\n";
+        // A vertical jitter would break the row pairing
+        int m0 = y1, m1 = y1, S = 0;
+        if (escape::real_symmetric<F> && jy == 0.0) mirror_range(y0, y1, m0, m1, S);
+
+        auto compute = [&](int r0, int r1) {
+            if (r0 >= r1) return;
+            escape::split_rows(r0, r1, threadCount, [=](int a, int b) {
+                escape::render_rows<F, typename K::real, Color>(
+                    dst + size_t(a - y0) * width, v, a, b, jx, jy);
+            });
+        };
+        compute(y0, m0);
+        compute(m1, y1);
+        for (int y = m0; y < m1; ++y)
+            std::memcpy(dst + size_t(y - y0) * width, dst + size_t(S - y - y0) * width,
+                        size_t(width) * sizeof(Out));
+    });
+}
+
+void Fractal::compute_rows(uint32_t* dst, int y0, int y1, int threadCount) const {
+    run_kernel<escape::Gray>(dst, y0, y1, threadCount);
+}
+
+void Fractal::compute_rows_jittered(uint32_t* dst, int y0, int y1, double jx, double jy,
+                                    int threadCount) const {
+    run_kernel<escape::Gray>(dst, y0, y1, threadCount, jx, jy);
+}
+
+void Fractal::compute_field(uint32_t* iters, float* smooth, int y0, int y1, int threadCount) const {
+    if (iters)  run_kernel<escape::Iterations>(iters, y0, y1, threadCount);
+    if (smooth) run_kernel<escape::Smooth>(smooth, y0, y1, threadCount);
+}
+
+size_t Fractal::compute_rows_aa(uint32_t* dst, int y0, int y1, int grid, int threshold,
+                                int threadCount) const {
+    // pass 1: one sample per pixel, with a row of halo above/below for the neighbour test
+    int h0 = std::max(0, y0 - 1), h1 = std::min(height, y1 + 1);
+    std::vector<uint32_t> iters(size_t(h1 - h0) * width);
+    compute_field(iters.data(), nullptr, h0, h1, threadCount);
+
+    // pass 2: colour, supersampling only where the neighbourhood disagrees
+    const uint32_t* it = iters.data();
+    const int w = width;
+    return supersample_rows(dst, y0, y1, grid, it, h0, threadCount, [=](int x, int y) {
+        const uint32_t* row = it + size_t(y - h0) * w;
+        const uint32_t* up  = y > h0     ? row - w : row;
+        const uint32_t* dn  = y + 1 < h1 ? row + w : row;
+        int n  = int(row[x]);
+        int xl = x > 0 ? x - 1 : x, xr = x + 1 < w ? x + 1 : x;
+        int d  = std::max({ std::abs(n - int(row[xl])), std::abs(n - int(row[xr])),
+                            std::abs(n - int(up[x])),   std::abs(n - int(dn[x])) });
+        return d > threshold;
+    });
+}
+
+size_t Fractal::compute_rows_aa_de(uint32_t* dst, int y0, int y1, int grid, double radius,
+                                   int threadCount) const {
+    int h0 = std::max(0, y0 - 1), h1 = std::min(height, y1 + 1);
+    std::vector<uint32_t> iters(size_t(h1 - h0) * width);
+    std::vector<float> de(iters.size());
+    if (!distance_field(iters.data(), de.data(), h0, h1, threadCount))
+        return compute_rows_aa(dst, y0, y1, grid, 2, threadCount);
+
+    // an outside pixel is refined when the boundary may be within radius pixels;
+    // an inside one when the boundary passes between it and a neighbour
+    const float near = float(radius * reFactor);
+    const float* d = de.data();
+    const int w = width;
+    return supersample_rows(dst, y0, y1, grid, iters.data(), h0, threadCount, [=](int x, int y) {
+        const float* row = d + size_t(y - h0) * w;
+        if (row[x] >= 0.0f) return row[x] < near;
+        const float* up = y > h0     ? row - w : row;
+        const float* dn = y + 1 < h1 ? row + w : row;
+        int xl = x > 0 ? x - 1 : x, xr = x + 1 < w ? x + 1 : x;
+        return row[xl] >= 0.0f || row[xr] >= 0.0f || up[x] >= 0.0f || dn[x] >= 0.0f;
+    });
+}
+
+template <class Need>
+size_t Fractal::supersample_rows(uint32_t* dst, int y0, int y1, int grid, const uint32_t* iters,
+                                 int h0, int threadCount, Need need) const {
+    trace::Span span("fractal", "supersample", y0, y1);
+    const double rF = reFactor, iF = imFactor;
+    const escape::View v = view();
+    std::atomic<size_t> total{0};
+
+    escape::dispatch(formula, precision, false, [&](auto kern) {
+        using K = decltype(kern);
+        escape::split_rows(y0, y1, threadCount, [&, rF, iF](int a, int b) {
+            size_t count = 0;
+            for (int y = a; y < b; ++y) {
+                const uint32_t* row = &iters[size_t(y - h0) * width];
+                uint32_t* out = dst + size_t(y - y0) * width;
+
+                for (int x = 0; x < width; ++x) {
+                    if (!need(x, y)) {
+                        out[x] = escape::Gray::value(int(row[x]), maxIter);
+                        continue;
+                    }
+
+                    uint32_t r = 0, g = 0, bl = 0;
+                    for (int sy = 0; sy < grid; ++sy) {
+                        double ci = maxIm - (y + (sy + 0.5) / grid - 0.5) * iF;
+                        for (int sx = 0; sx < grid; ++sx) {
+                            double cr = minRe + (x + (sx + 0.5) / grid - 0.5) * rF;
+                            uint32_t c = escape::sample<typename K::formula, typename K::real,
+                                                        escape::Gray>(v, cr, ci);
+                            r += (c >> 16) & 0xFF; g += (c >> 8) & 0xFF; bl += c & 0xFF;
+                        }
+                    }
+                    uint32_t k = uint32_t(grid * grid);
+                    out[x] = 0xFF000000u | ((r + k/2) / k) << 16 | ((g + k/2) / k) << 8 | ((bl + k/2) / k);
+                    ++count;
+                }
+            }
+            total += count;
+        });
+    });
+    return total;
+}
+
+bool Fractal::distance_field(uint32_t* iters, float* de, int y0, int y1, int threadCount) const {
+    trace::Span span("fractal", "distance", y0, y1);
+    bool ok = false;
+    const escape::View v = view();
+    escape::dispatch(formula, precision, false, [&](auto k) {
+        using K = decltype(k);
+        using F = typename K::formula;
+        if constexpr (F::analytic) {
+            int m0 = y1, m1 = y1, S = 0;
+            if (escape::real_symmetric<F>) mirror_range(y0, y1, m0, m1, S);
+
+            auto compute = [&](int r0, int r1) {
+                if (r0 >= r1) return;
+                escape::split_rows(r0, r1, threadCount, [=](int a, int b) {
+                    size_t off = size_t(a - y0) * width;
+                    escape::distance_rows<F, typename K::real>(iters ? iters + off : nullptr,
+                                                               de + off, v, a, b);
+                });
+            };
+            compute(y0, m0);
+            compute(m1, y1);
+            for (int y = m0; y < m1; ++y) {
+                size_t dst = size_t(y - y0) * width, src = size_t(S - y - y0) * width;
+                std::memcpy(de + dst, de + src, size_t(width) * sizeof(float));
+                if (iters) std::memcpy(iters + dst, iters + src, size_t(width) * sizeof(uint32_t));
+            }
+            ok = true;
+        }
+    });
+    return ok;
+}
+
+bool Fractal::compute_rows_de(uint32_t* dst, int y0, int y1, int threadCount) const {
+    std::vector<float> de(size_t(y1 - y0) * width);
+    if (!distance_field(nullptr, de.data(), y0, y1, threadCount)) return false;
+    for (size_t i = 0; i < de.size(); ++i) dst[i] = escape::line_value(de[i], reFactor);
+    return true;
 }
 
 void Fractal::zoomAt(int mx, int my, int dir) {
@@ -94,31 +383,3 @@ void Fractal::pan(int dx, int dy) {
     minIm -= dIm; maxIm -= dIm;
     update_factors();
 }
-
-void Fractal::render_section(uint32_t* pix,
-                             int w, int h,
-                             double minR, double maxR,
-                             double minI, double maxI,
-                             int y0, int y1)
-{
-    const int maxIter = 500;
-    double rF = (maxR - minR) / double(w - 1);
-    double iF = (maxI - minI) / double(h - 1);
-
-    for (int y = y0; y < y1; ++y) {
-        for (int x = 0; x < w; ++x) {
-            double c_re = minR + x * rF;
-            double c_im = maxI - y * iF;
-            double zr = 0.0, zi = 0.0;
-            int n = 0;
-            while (n < maxIter && zr*zr + zi*zi <= 4.0) {
-                double tmp = zr*zr - zi*zi + c_re;
-                zi = 2.0 * zr * zi + c_im;
-                zr = tmp;
-                ++n;
-            }
-            uint8_t s = uint8_t(255 - (255.0 * n / maxIter));
-            pix[y * w + x] = (255u << 24) | (s << 16) | (s << 8) | s; // ARGB gray
-        }
-    }
-}
@@ -0,0 +1,148 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+
+namespace metrics {
+
+namespace {
+
+std::mutex   mtx;           // guards everything below
+Frame        lastFrame;
+Totals       sums;
+uint64_t     nextSeq = 1;
+std::FILE*   out = nullptr;     // JSON lines log
+int          logInterval = 0;
+std::chrono::steady_clock::time_point lastTotals;
+
+void write_totals(const char* type) {
+    std::fprintf(out, "{\"type\":\"%s\",\"frames\":%llu,\"wall_ms\":%.3f,\"max_wall_ms\":%.3f,"
+                      "\"iterations\":%llu,\"computed\":%llu,\"reused\":%llu,\"peak_buffer_bytes\":%zu}\n",
+                 type, (unsigned long long)sums.frames, sums.wallMs, sums.maxWallMs,
+                 (unsigned long long)sums.iterations, (unsigned long long)sums.computed,
+                 (unsigned long long)sums.reused, sums.peakBufferBytes);
+}
+
+void write_frame(const Frame& f) {
+    std::fprintf(out, "{\"type\":\"frame\",\"seq\":%llu,\"source\":\"%s\",\"wall_ms\":%.3f,\"threads\":%d,"
+                      "\"busy_ms\":[", (unsigned long long)f.seq, f.source, f.wallMs, f.threads);
+    for (size_t i = 0; i < f.busyMs.size(); ++i)
+        std::fprintf(out, "%s%.3f", i ? "," : "", f.busyMs[i]);
+    std::fprintf(out, "],\"iterations\":%llu,\"computed\":%llu,\"reused\":%llu,\"buffer_bytes\":%zu}\n",
+                 (unsigned long long)f.iterations, (unsigned long long)f.computed,
+                 (unsigned long long)f.reused, f.bufferBytes);
+}
+
+void record(Frame& f) {
+    std::lock_guard<std::mutex> lock(mtx);
+    f.seq = nextSeq++;
+    ++sums.frames;
+    sums.wallMs    += f.wallMs;
+    sums.maxWallMs  = std::max(sums.maxWallMs, f.wallMs);
+    sums.iterations += f.iterations;
+    sums.computed   += f.computed;
+    sums.reused     += f.reused;
+    sums.peakBufferBytes = std::max(sums.peakBufferBytes, f.bufferBytes);
+    lastFrame = f;
+
+    if (out) {
+        write_frame(f);
+        auto now = std::chrono::steady_clock::now();
+        if (logInterval > 0 && now - lastTotals >= std::chrono::milliseconds(logInterval)) {
+            write_totals("totals");
+            lastTotals = now;
+        }
+        std::fflush(out);
+    }
+}
+
+} // namespace
+
+Frame last() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return lastFrame;
+}
+
+Totals totals() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return sums;
+}
+
+bool open_log(const std::string& path, int intervalMs) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (out) std::fclose(out);
+    try {
+        std::filesystem::path p(path);
+        if (p.has_parent_path()) std::filesystem::create_directories(p.parent_path());
+    } catch (...) {}
+    out = std::fopen(path.c_str(), "a");
+    if (!out) {
+        std::cerr << "Cannot open metrics out " << path << "\n";
+        return false;
+    }
+    logInterval = intervalMs;
+    lastTotals  = std::chrono::steady_clock::now();
+    return true;
+}
+
+void close_log() {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!out) return;
+    write_totals("summary");
+    std::fclose(out);
+    out = nullptr;
+}
+
+FrameScope::FrameScope(const char* source, int threads) {
+    frame.source  = source;
+    frame.threads = threads;
+    if (!escape::slice_probe)     { escape::slice_probe = this;      ownsProbe = true; }
+    if (!escape::iteration_count) { escape::iteration_count = &iters; ownsCount = true; }
+    t0 = Clock::now();
+}
+
+FrameScope::~FrameScope() {
+    if (ownsProbe) escape::slice_probe = nullptr;
+    if (ownsCount) escape::iteration_count = nullptr;
+}
+
+void FrameScope::slices(int n) {
+    if (int(sliceT0.size()) >= n) return;
+    sliceT0.resize(n);
+    frame.busyMs.resize(n, 0.0);
+}
+
+void FrameScope::begin(int i) {
+    sliceT0[i] = Clock::now();
+}
+
+void FrameScope::end(int i) {
+    frame.busyMs[i] += std::chrono::duration<double, std::milli>(Clock::now() - sliceT0[i]).count();
+}
+
+void FrameScope::finish(uint64_t computed, uint64_t reused, size_t bufferBytes,
+                        uint64_t extraIterations) {
+    if (done) return;
+    done = true;
+    frame.wallMs      = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    frame.iterations  = iters.load() + extraIterations;
+    frame.computed    = computed;
+    frame.reused      = reused;
+    frame.bufferBytes = bufferBytes;
+    if (ownsProbe) escape::slice_probe = nullptr;
+    if (ownsCount) escape::iteration_count = nullptr;
+    ownsProbe = ownsCount = false;
+    record(frame);
+
+    if (console) {
+        uint64_t total = computed + reused;
+        std::printf("[%s] %.1f ms (%d threads, %.1f Miter, %.0f%% reused)\n", frame.source,
+                    frame.wallMs, frame.threads, frame.iterations / 1e6,
+                    total ? 100.0 * reused / total : 0.0);
+    }
+}
+
+} // namespace metrics
@@ -0,0 +1,105 @@
+#include "perfcount.h"
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char* PerfCounters::name(Event e) {
+    switch (e) {
+    case Cycles:       return "cycles";
+    case Instructions: return "instructions";
+    case BranchMisses: return "branch_misses";
+    case CacheMisses:  return "cache_misses";
+    default:           return "?";
+    }
+}
+
+#ifdef __linux__
+
+PerfCounters::PerfCounters(bool inherit) {
+    static const uint64_t configs[EventCount] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES,
+    };
+    for (int e = 0; e < EventCount; ++e) {
+        count[e] = 0;
+        perf_event_attr a;
+        std::memset(&a, 0, sizeof(a));
+        a.size           = sizeof(a);
+        a.type           = PERF_TYPE_HARDWARE;
+        a.config         = configs[e];
+        a.disabled       = 1;
+        a.inherit        = inherit ? 1 : 0;
+        a.exclude_kernel = 1;
+        a.exclude_hv     = 1;
+        a.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fd[e] = int(syscall(SYS_perf_event_open, &a, 0, -1, -1, 0));
+        if (fd[e] < 0 && why.empty())
+            why = std::string(name(Event(e))) + ": " + std::strerror(errno);
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (int e = 0; e < EventCount; ++e)
+        if (fd[e] >= 0) close(fd[e]);
+}
+
+void PerfCounters::start() {
+    for (int e = 0; e < EventCount; ++e) {
+        if (fd[e] < 0) continue;
+        ioctl(fd[e], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd[e], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void PerfCounters::stop() {
+    for (int e = 0; e < EventCount; ++e) {
+        if (fd[e] < 0) continue;
+        ioctl(fd[e], PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t r[3] = { 0, 0, 0 };    // value, time enabled, time running
+        if (read(fd[e], r, sizeof(r)) != ssize_t(sizeof(r))) { count[e] = 0; continue; }
+        // more events than PMU slots: the kernel time-shares them, scale up
+        count[e] = r[2] > 0 && r[2] < r[1] ? uint64_t(double(r[0]) * r[1] / r[2]) : r[0];
+    }
+}
+
+#else
+
+PerfCounters::PerfCounters(bool) : why("perf_event_open is Linux only") {
+    for (int e = 0; e < EventCount; ++e) { fd[e] = -1; count[e] = 0; }
+}
+PerfCounters::~PerfCounters() {}
+void PerfCounters::start() {}
+void PerfCounters::stop() {}
+
+#endif
+
+bool PerfCounters::available() const {
+    for (int e = 0; e < EventCount; ++e)
+        if (fd[e] >= 0) return true;
+    return false;
+}
+
+void PerfTotals::add(const PerfCounters& c) {
+    for (int e = 0; e < PerfCounters::EventCount; ++e) {
+        if (!c.has(PerfCounters::Event(e))) continue;
+        has[e] = true;
+        v[e] += double(c.value(PerfCounters::Event(e)));
+    }
+}
+
+void PerfTotals::scale(double f) {
+    for (double& x : v) x *= f;
+}
+
+double PerfTotals::ipc() const {
+    if (!has[PerfCounters::Cycles] || !has[PerfCounters::Instructions]) return 0.0;
+    double c = v[PerfCounters::Cycles];
+    return c > 0 ? v[PerfCounters::Instructions] / c : 0.0;
+}
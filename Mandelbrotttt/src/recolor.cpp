@@ -0,0 +1,137 @@
+#include "recolor.h"
+#include "field.h"
+#include "image_save.h"
+#include "escape.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+static uint32_t lerp_argb(uint32_t a, uint32_t b, float t) {
+    auto ch = [&](int s) {
+        float x = float((a >> s) & 0xFF), y = float((b >> s) & 0xFF);
+        return uint32_t(x + (y - x) * t + 0.5f) << s;
+    };
+    return 0xFF000000u | ch(16) | ch(8) | ch(0);
+}
+
+static std::vector<uint32_t> gradient(const std::vector<uint32_t>& stops, int n) {
+    std::vector<uint32_t> lut(n);
+    int segs = int(stops.size());                 // cyclic: last stop blends back into the first
+    for (int i = 0; i < n; ++i) {
+        float p = float(i) * segs / n;
+        int   k = int(p);
+        lut[i] = lerp_argb(stops[k], stops[(k + 1) % segs], p - k);
+    }
+    return lut;
+}
+
+Palette Palette::make(const std::string& name, int maxIter) {
+    Palette p;
+    if (name == "julia") {
+        // escape::Bands without the inside test (inside is handled by operator())
+        p.lut.resize(256);
+        for (int n = 0; n < 256; ++n) {
+            uint8_t r = (n * 9) % 256, g = (n * 7) % 256, b = (n * 5) % 256;
+            p.lut[n] = (0xFFu << 24) | (r << 16) | (g << 8) | b;
+        }
+        p.cyclic = true;
+    } else if (name == "fire" || name == "ocean") {
+        p.lut = name == "fire"
+              ? gradient({ 0xFF000000u, 0xFF7F0000u, 0xFFFF4000u, 0xFFFFC000u, 0xFFFFFFC0u }, 256)
+              : gradient({ 0xFF000020u, 0xFF003070u, 0xFF0090C0u, 0xFF80F0FFu, 0xFFFFFFFFu }, 256);
+        p.scale  = 256.0f / 64.0f;
+        p.cyclic = true;
+    } else {
+        // gray: the Mandelbrot view's ramp
+        p.lut.resize(size_t(maxIter) + 1);
+        for (int n = 0; n <= maxIter; ++n) p.lut[n] = escape::Gray::value(n, maxIter);
+        p.inside = p.lut[maxIter];
+    }
+    return p;
+}
+
+static bool ends_with(const std::string& s, const std::string& suf) {
+    return s.size() >= suf.size() && s.compare(s.size() - suf.size(), suf.size(), suf) == 0;
+}
+
+template <class Writer>
+static bool recolor_into(const FieldReader& in, const Palette& pal, Writer& out) {
+    const FieldHeader& h = in.header();
+    const int w = int(h.width), H = int(h.height), maxIter = h.maxIter;
+    const int bandRows = std::max(1, int((16u << 20) / (size_t(w) * 4)));
+
+    std::vector<uint32_t> samples(in.samples() ? 0 : size_t(w) * bandRows);
+    std::vector<uint32_t> band(size_t(w) * bandRows);
+
+    // output rows go bottom-up like every other writer here, so walk bands from the bottom
+    for (int y1 = H; y1 > 0 && out.ok(); y1 -= bandRows) {
+        int y0 = std::max(0, y1 - bandRows);
+        const uint8_t* src;
+        if (in.samples()) {
+            src = static_cast<const uint8_t*>(in.samples()) + size_t(y0) * w * 4;
+        } else {
+            if (!in.read_rows(y0, y1, samples.data())) return false;
+            src = reinterpret_cast<const uint8_t*>(samples.data());
+        }
+
+        size_t n = size_t(y1 - y0) * w;
+        if (h.sample == FIELD_SMOOTH_F32) {
+            for (size_t i = 0; i < n; ++i) {
+                float v;
+                std::memcpy(&v, src + i * 4, 4);
+                band[i] = pal(v, maxIter);
+            }
+        } else {
+            for (size_t i = 0; i < n; ++i) {
+                uint32_t it;
+                std::memcpy(&it, src + i * 4, 4);
+                band[i] = pal(float(it), maxIter);
+            }
+        }
+        out.write_rows(band.data() + size_t(y1 - y0 - 1) * w, y1 - y0, -(long long)w);
+    }
+    return out.finish();
+}
+
+int run_recolor(const std::string& in, const std::string& out, const std::string& palette) {
+    FieldReader field(in);
+    if (!field.ok()) {
+        std::cerr << "Recolor: can't read field file " << in << "\n";
+        return 1;
+    }
+    const FieldHeader& h = field.header();
+    // the gray palette is a maxIter + 1 entry table, so keep it to something sane
+    constexpr int maxIterCap = 1 << 24;
+    if (h.maxIter < 1 || h.maxIter > maxIterCap) {
+        std::cerr << "Recolor: " << in << " has maxIter " << h.maxIter
+                  << " (expected 1.." << maxIterCap << ")\n";
+        return 1;
+    }
+    Palette pal = Palette::make(palette, h.maxIter);
+
+    std::cout << "Recolor " << in << " (" << h.width << "x" << h.height
+              << (h.sample == FIELD_SMOOTH_F32 ? ", smooth" : ", iterations")
+              << ", maxIter " << h.maxIter << ") -> " << out << " [" << palette << "]\n";
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+    bool ok;
+    if (ends_with(out, ".qoi")) {
+        QoiWriter qoi(out, int(h.width), int(h.height));
+        ok = recolor_into(field, pal, qoi);
+    } else {
+        PngWriter png(out, int(h.width), int(h.height));
+        ok = recolor_into(field, pal, png);
+    }
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    if (!ok) {
+        std::cerr << "Recolor failed: " << out << "\n";
+        return 1;
+    }
+    std::cout << "Saved " << out << " ("
+              << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count() << " ms)\n";
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include "trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace trace {
+
+namespace {
+
+struct Event {
+    const char* cat;
+    const char* name;
+    double ts, dur;     // microseconds
+    int a, b;
+};
+
+struct Buffer {
+    std::mutex m;       // owner appends, stop() reads
+    int tid = 0;
+    bool inUse = false;
+    const char* label = nullptr;
+    std::vector<Event> events;
+};
+
+using Clock = std::chrono::steady_clock;
+
+std::mutex regMutex;                            // guards everything below
+std::vector<std::unique_ptr<Buffer>> buffers;   // never freed: threads keep pointers
+std::string outPath;
+const Clock::time_point epoch = Clock::now();
+std::atomic<int> sessionId{0};
+
+Buffer* acquire() {
+    std::lock_guard<std::mutex> lock(regMutex);
+    for (auto& b : buffers) {
+        if (!b->inUse) { b->inUse = true; b->label = nullptr; return b.get(); }
+    }
+    buffers.push_back(std::make_unique<Buffer>());
+    Buffer* b = buffers.back().get();
+    b->tid   = int(buffers.size());
+    b->inUse = true;
+    return b;
+}
+
+// the calling thread's buffer, returned to the pool when the thread exits
+struct Slot {
+    Buffer* buf = nullptr;
+    ~Slot() {
+        if (!buf) return;
+        std::lock_guard<std::mutex> lock(regMutex);
+        buf->inUse = false;
+    }
+};
+thread_local Slot slot;
+thread_local const char* label = nullptr;
+
+Buffer& mine() {
+    if (!slot.buf) slot.buf = acquire();
+    return *slot.buf;
+}
+
+double now_us() {
+    return std::chrono::duration<double, std::micro>(Clock::now() - epoch).count();
+}
+
+} // namespace
+
+bool start(const std::string& path) {
+    std::lock_guard<std::mutex> lock(regMutex);
+    if (recording.load()) return false;
+    for (auto& b : buffers) {
+        std::lock_guard<std::mutex> bl(b->m);
+        b->events.clear();
+    }
+    outPath = path;
+    ++sessionId;
+    recording.store(true);
+    return true;
+}
+
+bool active() {
+    return recording.load();
+}
+
+void name_thread(const char* name) {
+    label = name;
+}
+
+void Span::begin(const char* c, const char* n, int y0, int y1) {
+    cat = c; name = n; a = y0; b = y1;
+    session = sessionId.load(std::memory_order_relaxed);
+    t0 = now_us();
+}
+
+void Span::end() {
+    double t1 = now_us();
+    // a span that straddles stop() (or a stop/start) is dropped
+    if (!recording.load(std::memory_order_relaxed) ||
+        sessionId.load(std::memory_order_relaxed) != session) return;
+    Buffer& buf = mine();
+    std::lock_guard<std::mutex> lock(buf.m);
+    buf.label = label;
+    buf.events.push_back({ cat, name, t0, t1 - t0, a, b });
+}
+
+bool stop() {
+    std::lock_guard<std::mutex> lock(regMutex);
+    if (!recording.exchange(false)) return false;
+
+    try {
+        std::filesystem::path p(outPath);
+        if (p.has_parent_path()) std::filesystem::create_directories(p.parent_path());
+    } catch (...) {}
+    std::FILE* f = std::fopen(outPath.c_str(), "w");
+    if (!f) {
+        std::cerr << "Cannot write trace " << outPath << "\n";
+        return false;
+    }
+
+    size_t count = 0;
+    bool first = true;
+    auto sep = [&]() { std::fputs(first ? "\n" : ",\n", f); first = false; };
+    std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", f);
+    for (auto& b : buffers) {
+        std::lock_guard<std::mutex> bl(b->m);
+        if (b->events.empty()) continue;
+        sep();
+        if (!b->label)
+            std::fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                            "\"args\":{\"name\":\"thread %d\"}}", b->tid, b->tid);
+        else
+            std::fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                            "\"args\":{\"name\":\"%s\"}}", b->tid, b->label);
+        for (const Event& e : b->events) {
+            sep();
+            std::fprintf(f, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                            "\"pid\":1,\"tid\":%d", e.name, e.cat, e.ts, e.dur, b->tid);
+            if (e.a >= 0) std::fprintf(f, ",\"args\":{\"y0\":%d,\"y1\":%d}", e.a, e.b);
+            std::fputs("}", f);
+        }
+        count += b->events.size();
+        b->events.clear();
+        b->events.shrink_to_fit();
+    }
+    std::fputs("\n]}\n", f);
+    bool ok = std::fclose(f) == 0;
+    if (ok) std::cout << "Trace: " << count << " spans written to " << outPath << "\n";
+    else    std::cerr << "Trace write failed: " << outPath << "\n";
+    return ok;
+}
+
+} // namespace trace
@@ -0,0 +1,211 @@
+#include "verify.h"
+#include "mandelbrot.h"
+#include "julia.h"
+#include "image_save.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Viewport {
+    const char* name;
+    bool   julia;
+    double re, im, span;    // centre and width (Julia: offset from its default view)
+    int    maxIter;         // Mandelbrot only; Julia::maxIter is fixed
+};
+
+const Viewport viewports[] = {
+    { "full",      false, -0.5,               0.0,               3.0,   500  },
+    { "seahorse",  false, -0.745,             0.105,             0.03,  500  },
+    { "axis",      false, -1.375,             0.0,               0.25,  1000 },
+    { "deep",      false, -0.743643887037151, 0.131825904205330, 1e-9,  2000 },
+    { "julia",     true,  0.0,                0.0,               0.0,   0    },
+    { "julia-off", true,  0.137,              -0.061,            0.0,   0    },
+};
+
+struct Engine {
+    const char* name;
+    bool approximate;
+    // fills iters (width*height); false = engine doesn't apply here
+    std::function<bool(uint32_t* iters)> run;
+};
+
+struct Diff {
+    size_t mismatches = 0;
+    uint32_t maxDelta = 0;
+};
+
+Diff compare(const std::vector<uint32_t>& ref, const std::vector<uint32_t>& got, int tolerance) {
+    Diff d;
+    for (size_t i = 0; i < ref.size(); ++i) {
+        uint32_t delta = ref[i] > got[i] ? ref[i] - got[i] : got[i] - ref[i];
+        if (delta > uint32_t(tolerance)) ++d.mismatches;
+        d.maxDelta = std::max(d.maxDelta, delta);
+    }
+    return d;
+}
+
+// reference in dim gray, mismatches in red (brighter = larger difference)
+void write_diff(const std::string& path, const std::vector<uint32_t>& ref,
+                const std::vector<uint32_t>& got, int w, int h, int maxIter, int tolerance,
+                uint32_t maxDelta) {
+    std::vector<uint32_t> img(ref.size());
+    for (size_t i = 0; i < ref.size(); ++i) {
+        uint32_t delta = ref[i] > got[i] ? ref[i] - got[i] : got[i] - ref[i];
+        if (delta > uint32_t(tolerance)) {
+            uint32_t r = 128 + uint32_t(127.0 * std::log1p(double(delta)) / std::log1p(double(maxDelta)));
+            img[i] = 0xFF000000u | (r << 16);
+        } else {
+            uint32_t g = ref[i] >= uint32_t(maxIter) ? 0 : 40 + uint32_t(60.0 * ref[i] / maxIter);
+            img[i] = 0xFF000000u | (g << 16) | (g << 8) | g;
+        }
+    }
+    save_png_from_buffer(img.data(), w, h, path);
+}
+
+} // namespace
+
+int run_verify(const VerifyOptions& opt) {
+    if (opt.width < 2 || opt.height < 2) {
+        std::cerr << "Verify needs at least 2x2 pixels\n";
+        return 1;
+    }
+    try {
+        std::filesystem::create_directories(opt.outDir);
+    } catch (...) {}
+
+    const int W = opt.width, H = opt.height, T = opt.threads;
+    const size_t N = size_t(W) * H;
+    std::cout << "Verify " << W << "x" << H << ", " << escape::formula_name(opt.formula)
+              << ", tolerance " << opt.tolerance << ", max mismatch " << opt.maxMismatch
+              << "% (float " << opt.floatMismatch << "%)\n";
+
+    int failures = 0, checked = 0;
+    for (const Viewport& vp : viewports) {
+        std::stringstream list(opt.scenes);
+        std::string item;
+        bool wanted = opt.scenes.empty();
+        while (!wanted && std::getline(list, item, ',')) wanted = item == vp.name;
+        if (!wanted) continue;
+
+        // reference: every row, scalar double, one thread
+        escape::View v;
+        std::vector<Engine> engines;
+        if (vp.julia) {
+            auto julia = [&](escape::Precision p) {
+                auto j = std::make_shared<Julia>(W, H);
+                j->setFormula(opt.formula);
+                j->setPrecision(p);
+                j->minRe += vp.re; j->maxRe += vp.re;
+                j->minIm += vp.im; j->maxIm += vp.im;
+                return j;
+            };
+            v = julia(escape::Precision::Double)->view();
+            engines.push_back({ "threads", false, [=](uint32_t* it) {
+                julia(escape::Precision::Double)->compute_field(it, T);
+                return true; } });
+            engines.push_back({ "float", true, [=](uint32_t* it) {
+                julia(escape::Precision::Float)->compute_field(it, T);
+                return true; } });
+            engines.push_back({ "lanes4", false, [=](uint32_t* it) {
+                escape::dispatch(opt.formula, escape::Precision::Double, true, [&](auto k) {
+                    using F = typename decltype(k)::formula;
+                    constexpr int L = 4;
+                    const int per = int((N + L - 1) / L);
+                    const double rF = (v.maxRe - v.minRe) / (W - 1), iF = (v.maxIm - v.minIm) / (H - 1);
+                    double cr[L], ci[L];
+                    for (int l = 0; l < L; ++l) { cr[l] = v.cRe; ci[l] = v.cIm; }
+                    // lane l takes pixels [l * per, (l + 1) * per), padded with the last one
+                    escape::iterate_streams<F, L>(cr, ci, per, v.maxIter,
+                        [&](int l, int i, double& zr, double& zi) {
+                            size_t p = std::min(N - 1, size_t(l) * per + i);
+                            zr = escape::col_re(v, rF, int(p % W));
+                            zi = escape::row_im(v, iF, int(p / W));
+                        },
+                        [&](int l, int i, int n) {
+                            size_t p = size_t(l) * per + i;
+                            if (p < N) it[p] = uint32_t(n);
+                        });
+                });
+                return true; } });
+        } else {
+            auto fractal = [&](escape::Precision p, int maxIter) {
+                auto f = std::make_shared<Fractal>(W, H, false);
+                f->setFormula(opt.formula);
+                f->setPrecision(p);
+                f->setMaxIter(maxIter);
+                f->setView(vp.re, vp.im, vp.span);
+                return f;
+            };
+            v = fractal(escape::Precision::Double, vp.maxIter)->view();
+            engines.push_back({ "threads", false, [=](uint32_t* it) {
+                fractal(escape::Precision::Double, vp.maxIter)->compute_field(it, nullptr, 0, H, T);
+                return true; } });
+            engines.push_back({ "bands", false, [=](uint32_t* it) {
+                auto f = fractal(escape::Precision::Double, vp.maxIter);
+                for (int y = 0; y < H; y += 37)
+                    f->compute_field(it + size_t(y) * W, nullptr, y, std::min(H, y + 37), T);
+                return true; } });
+            engines.push_back({ "resume", false, [=](uint32_t* it) {
+                Fractal f(W, H);
+                f.setFormula(opt.formula);
+                f.setMaxIter(std::max(1, vp.maxIter / 2));
+                f.setView(vp.re, vp.im, vp.span);
+                f.setKeepOrbits(true);
+                f.compute(T);
+                f.raise_max_iter(vp.maxIter, T);
+                return f.orbit_counts(it); } });
+            engines.push_back({ "float", true, [=](uint32_t* it) {
+                // pixel spacing below a few float ulps of the coordinates: not meaningful
+                double ulp = std::max(std::abs(vp.re), std::abs(vp.im)) * 1.2e-7;
+                if (vp.span / W < 8 * ulp) return false;
+                fractal(escape::Precision::Float, vp.maxIter)->compute_field(it, nullptr, 0, H, T);
+                return true; } });
+        }
+
+        std::vector<uint32_t> ref(N), got(N);
+        escape::dispatch(opt.formula, escape::Precision::Double, vp.julia, [&](auto k) {
+            using K = decltype(k);
+            escape::render_rows<typename K::formula, typename K::real, escape::Iterations>(
+                ref.data(), v, 0, H);
+        });
+
+        for (const Engine& e : engines) {
+            std::fill(got.begin(), got.end(), 0u);
+            if (!e.run(got.data())) {
+                std::printf("  %-9s %-7s n/a\n", vp.name, e.name);
+                continue;
+            }
+            ++checked;
+            Diff d = compare(ref, got, opt.tolerance);
+            double pct = 100.0 * d.mismatches / N;
+            bool ok = pct <= (e.approximate ? opt.floatMismatch : opt.maxMismatch);
+            failures += ok ? 0 : 1;
+            std::printf("  %-9s %-7s %8zu mismatches (%7.3f%%)  max diff %5u  %s\n", vp.name, e.name,
+                        d.mismatches, pct, d.maxDelta, ok ? (d.mismatches ? "ok (within limit)" : "ok") : "FAIL");
+            if (d.mismatches) {
+                std::string path = (std::filesystem::path(opt.outDir) /
+                                    (std::string(vp.name) + "_" + e.name + "_diff.png")).string();
+                write_diff(path, ref, got, W, H, v.maxIter, opt.tolerance, d.maxDelta);
+            }
+        }
+    }
+    if (checked == 0) {
+        std::cerr << "No verify viewport matches \"" << opt.scenes
+                  << "\" (full, seahorse, axis, deep, julia, julia-off)\n";
+        return 1;
+    }
+    std::cout << (failures ? std::to_string(failures) + " engine check(s) failed\n"
+                           : std::string("All engines match the reference\n"));
+    return failures ? 2 : 0;
+}